@@ -505,6 +505,27 @@ typedef void (*FUNC_PTR)(void);
 typedef struct CSVFile CSVFile;
 
 
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+// Opaque handle for a lookup table of the rows in a csv file by the text in one column
+typedef struct CSVRowIndex CSVRowIndex;
+
+
+// Opaque handle for the rows that matched a query on a csv file
+typedef struct CSVQueryResult CSVQueryResult;
+
+
+// Opaque handle for a csv file being written
+typedef struct CSVWriter CSVWriter;
+
+
+// A string that is not null terminated, `length` is the number of bytes in `text`
+typedef struct CSVStringView {
+        const char* text;
+        uint32_t length;
+} CSVStringView;
+#endif
+
+
 
 ///////////////////////////////////////////////////////////////////////////////
 //                 11) Enums 
@@ -523,6 +544,69 @@ typedef enum ConfigAction {
 } ConfigAction;
 
 
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+// Options for loading a csv file with the CSV API's LoadEx function, these can be combined
+// CSVLoad_Parallel - tokenize large files on multiple threads, the result is identical to
+//                    a normal load and small files are still loaded on the calling thread
+// CSVLoad_MemoryMapped - read the cells directly from a copy-on-write mapping of the file
+//                        instead of reading the whole file into a separate buffer first,
+//                        the cells are null terminated in place when the file is loaded so
+//                        the csv can be read from any thread. The file stays open until the
+//                        csv is closed and must not be modified while it is open. Falls back
+//                        to a normal load if the file cannot be mapped.
+// CSVLoad_UseIndex - keep a "<filename>.index" file next to the csv with the tokenized cells,
+//                    when the csv has not changed since the index was written (same size,
+//                    modified time, and content hash) the index is used instead of parsing
+//                    the file again, otherwise the file is parsed and the index is rewritten.
+//                    With CSVLoad_Unescape the index holds the unescaped cells, an index
+//                    written without it (or the other way around) is rewritten.
+// CSVLoad_Unescape - remove the quotes around quoted cells and replace "" with " when the
+//                    file is loaded, so ReadCell and ReadCellView return the final text and
+//                    ParseStringCSV is not needed. Without this flag quoted cells are returned
+//                    as they are in the file minus the opening quote.
+typedef enum CSVLoadFlags {
+        CSVLoad_Default = 0,
+        CSVLoad_Parallel = 1 << 0,
+        CSVLoad_MemoryMapped = 1 << 1,
+        CSVLoad_UseIndex = 1 << 2,
+        CSVLoad_Unescape = 1 << 3,
+} CSVLoadFlags;
+
+
+// The type of the values when reading a whole csv column with the CSV API's ReadColumn function
+// each type is parsed the same way as the matching function in the Parse API, so reading
+// a column gives the same values as calling ReadCell and then ParseU32 (etc.) on every row
+// CSVColumn_U32 - uint32_t, same as ParseU32 (decimal, or hexadecimal if the text starts with 0x)
+// CSVColumn_S64 - int64_t, same as ParseS64
+// CSVColumn_Float - float, same as ParseFloat
+// CSVColumn_Double - double, same as ParseDouble
+// CSVColumn_Bool - bool, same as ParseBool
+// CSVColumn_String - CSVStringView of the cell text exactly as ReadCell returns it, never fails
+typedef enum CSVColumnType {
+        CSVColumn_U32,
+        CSVColumn_S64,
+        CSVColumn_Float,
+        CSVColumn_Double,
+        CSVColumn_Bool,
+        CSVColumn_String,
+} CSVColumnType;
+
+
+// How a filter in a csv query compares the cells of a column to the filter value
+// numbers are compared by value, strings are compared byte by byte like strcmp
+// CSVCompare_Contains - the cell text contains the filter text, only for CSVColumn_String
+typedef enum CSVCompare {
+        CSVCompare_Equal,
+        CSVCompare_NotEqual,
+        CSVCompare_Less,
+        CSVCompare_LessEqual,
+        CSVCompare_Greater,
+        CSVCompare_GreaterEqual,
+        CSVCompare_Contains,
+} CSVCompare;
+#endif
+
+
 ///////////////////////////////////////////////////////////////////////////////
 //                 12) Callback Types 
 ///////////////////////////////////////////////////////////////////////////////
@@ -593,6 +677,21 @@ typedef const char* (*CALLBACK_SELECTIONLIST)(const void* userdata, uint32_t ind
 typedef void (*CALLBACK_TABLE)(uintptr_t table_userdata, int current_row, int current_column);
 
 
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+// For the csv streaming reader, called once for each row of the file in order.
+// 
+// `userdata` is any arbitrary data that you want to pass to the callback
+// 
+// `row` is the index of the row in the file
+// 
+// `cells` is an array of `cell_count` views of the cell text, the text is also
+//         null terminated. The views are only valid until the callback returns.
+// 
+// return false to stop reading the file early
+typedef bool (*CALLBACK_CSVROW)(uintptr_t userdata, uint64_t row, const CSVStringView* cells, uint32_t cell_count);
+#endif
+
+
 
 ///////////////////////////////////////////////////////////////////////////////
 //                 13) Callback API
@@ -714,14 +813,35 @@ struct config_api_t {
 
         // v1.4.2
         // read or write fixed size arbitrary data
-        // arbitrary data is stored hex encoded in the config file, this config option should be used
-        // to store larger or more complex data like POD structs
+        // arbitrary data is stored hex encoded in the config file (or base64 encoded if the user
+        // enabled that in the settings), this config option should be used to store larger or more
+        // complex data like POD structs, data larger than the 4kb output buffer is streamed in chunks
         // unlike other config functions, this one needs to report if the data was parsed correctly
-        // this function returns false if any non-hex characters were encountered while decoding or
+        // this function returns false if any invalid characters were encountered while decoding or
         // if the size of the encoded data does not match the `data_size` parameter
         // since config functions do not allocate, returning false on a read event means that `out_data`
         // may have been overwritten with garbage values and should not be trusted
         bool (*ConfigData)(ConfigAction action, const char* key_name, void* out_data, uint32_t data_size);
+
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+        // the functions above are namespaced to the mod whose config callback is running,
+        // so they can only be used inside your config callback. these read a setting of your
+        // mod from anywhere, including your own threads, while the settings are being saved
+        // or reloaded on another thread
+        //
+        // `handle` is the handle you created when registering your mod
+        //
+        // `key_name` and the value work the same as the config function of the same type
+        //
+        // returns false if the setting was not found or could not be parsed, in that case the
+        // value is not modified, except that ReadString still makes `out_buffer` an empty string
+        // and ReadData may have written garbage to `out_data` (see ConfigData)
+        bool (*ReadU32)(RegistrationHandle handle, const char* key_name, uint32_t* value);
+        bool (*ReadString)(RegistrationHandle handle, const char* key_name, char* out_buffer, uint32_t buffer_size);
+        bool (*ReadBool)(RegistrationHandle handle, const char* key_name, bool* out_value);
+        bool (*ReadFloat)(RegistrationHandle handle, const char* key_name, float* out_value);
+        bool (*ReadData)(RegistrationHandle handle, const char* key_name, void* out_data, uint32_t data_size);
+#endif
 };
 
 
@@ -977,6 +1097,17 @@ struct log_buffer_api_t {
         // Clear the log buffer
         void (*Clear)(LogBufferHandle handle);
 #endif
+
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+        // Limit the log buffer to `max_bytes` of text and `max_lines` lines, 0 means no limit
+        // when a new line does not fit the oldest lines are dropped to make room
+        // line numbers in GetLine always count from the oldest line still in the buffer
+        void (*SetLimits)(LogBufferHandle handle, uint32_t max_bytes, uint32_t max_lines);
+
+        // Get the number of lines dropped from the start of the buffer since it was created or cleared
+        // adding this to a line number gives a number that stays the same as old lines are dropped
+        uint64_t (*GetFirstLineNumber)(LogBufferHandle handle);
+#endif
 };
 
 
@@ -1099,6 +1230,46 @@ struct windows_api_t {
 ///////////////////////////////////////////////////////////////////////////////
 //                 21) CSV file API
 ///////////////////////////////////////////////////////////////////////////////
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+// Keep only the rows where the cell in `column` compares true against `value`
+// `type` is how the column is parsed (see CSVColumnType), rows that fail to parse never match
+// `value` is the text of the value to compare against, parsed the same way as the column
+typedef struct CSVQueryFilter {
+        uint32_t column;
+        CSVColumnType type;
+        CSVCompare compare;
+        const char* value;
+} CSVQueryFilter;
+
+
+// Sort the rows by the cells in `column` parsed as `type`, rows that fail to parse sort last
+typedef struct CSVQuerySort {
+        uint32_t column;
+        CSVColumnType type;
+        bool descending;
+} CSVQuerySort;
+
+
+// A query for the CSV API's Query function, zero initialize and fill in what you need
+// `filters` rows must match every filter to be in the result
+// `sort` the rows are sorted by the first key, ties are sorted by the next key and so on,
+//        rows that are still tied (or all rows if there are no sort keys) stay in file order
+// `columns` the columns of the result in the order they are shown, all columns if NULL
+// `first_row` rows before this are never in the result, use 1 to skip a header row
+// `limit` the maximum number of rows in the result, 0 for no limit
+typedef struct CSVQuery {
+        const CSVQueryFilter* filters;
+        uint32_t filter_count;
+        const CSVQuerySort* sort;
+        uint32_t sort_count;
+        const uint32_t* columns;
+        uint32_t column_count;
+        uint32_t first_row;
+        uint32_t limit;
+} CSVQuery;
+#endif
+
+
 struct csv_api_t {
         // Load a csv file
         // returns NULL on error
@@ -1124,6 +1295,145 @@ struct csv_api_t {
         // `column` is the column to read
         // returns a pointer to the cell text or NULL on error
         const char* (*ReadCell)(const CSVFile* csv, uint32_t row, uint32_t column);
+
+
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+        // Load a csv file with options
+        // returns NULL on error
+        // `filename` is the name of the csv file
+        // `flags` is zero or more CSVLoadFlags combined with bitwise or
+        CSVFile* (*LoadEx)(const char* filename, uint32_t flags);
+
+
+        // Read every row of a column into a typed array in one call
+        // large columns are converted on multiple threads
+        // returns the number of rows that failed to parse
+        // `csv` is a pointer to the csv structure
+        // `column` is the column to read
+        // `type` is the CSVColumnType of the elements in `out_values`
+        // `out_values` receives one element per row and must have room for every row in the csv,
+        //              rows that fail to parse are set to zero
+        // `out_row_errors` is optional (can be NULL), receives one bool per row set to true
+        //                  if that row failed to parse
+        uint32_t (*ReadColumn)(const CSVFile* csv, uint32_t column, CSVColumnType type, void* out_values, bool* out_row_errors);
+
+
+        // Read a csv file one row at a time without loading the whole file
+        // the file is read in fixed size blocks so memory use only depends on the longest row,
+        // use this for files that are too big to load (including files over 4GB)
+        // the rows and errors are the same as Load would give for the file, but rows before
+        // an error have already been sent to the callback by the time the error is found
+        // a row longer than 64MB is an error, this includes a file without any commas,
+        // which Load also refuses but Stream would otherwise have to read in whole first
+        // returns false if the file could not be opened or is not a valid csv file
+        // `filename` is the name of the csv file
+        // `callback` is called for each row
+        // `userdata` is passed to the callback
+        bool (*Stream)(const char* filename, CALLBACK_CSVROW callback, uintptr_t userdata);
+
+
+        // Build a hash table to find rows by the text in a key column (like a form id column)
+        // the index must be freed with FreeIndex before the csv is closed
+        // `csv` is a pointer to the csv structure
+        // `column` is the key column
+        // `build_in_background` true to build the index on a worker thread and return right away,
+        //                       use IndexReady to check if it is finished
+        CSVRowIndex* (*BuildIndex)(const CSVFile* csv, uint32_t column, bool build_in_background);
+
+
+        // Check if an index built in the background is finished
+        // FindRow and NextRow wait for the index to finish, so check this first if you dont want to wait
+        bool (*IndexReady)(const CSVRowIndex* index);
+
+
+        // Find the first row where the key column matches `key`
+        // returns the row or UINT32_MAX if no row matches
+        // `key` is compared to the cell text exactly as ReadCell returns it
+        uint32_t (*FindRow)(CSVRowIndex* index, const char* key);
+
+
+        // Find the next row with the same key as `row` for keys that are in more than one row
+        // returns the row or UINT32_MAX if there are no more rows with that key
+        uint32_t (*NextRow)(CSVRowIndex* index, uint32_t row);
+
+
+        // Free an index, waits for the index to finish if it is being built in the background
+        void (*FreeIndex)(CSVRowIndex* index);
+
+
+        // Read a cell along with its length
+        // the length is stored for files loaded with CSVLoad_Unescape or CSVLoad_UseIndex,
+        // for other files it is measured on every call
+        // `csv` is a pointer to the csv structure
+        // `row` is the row to read
+        // `column` is the column to read
+        // returns a view of the cell text, the text is also null terminated
+        CSVStringView (*ReadCellView)(const CSVFile* csv, uint32_t row, uint32_t column);
+
+
+        // Filter, sort, and pick columns from a csv file
+        // the columns used by filters and sort keys are parsed in bulk (on multiple threads
+        // for large files) and the result is a list of row numbers into the csv
+        // the csv must stay open until the result is freed
+        // returns NULL if a filter value cannot be parsed as the type of its column
+        // `csv` is a pointer to the csv structure
+        // `query` describes the query, see CSVQuery
+        CSVQueryResult* (*Query)(const CSVFile* csv, const CSVQuery* query);
+
+
+        // Get the number of rows in a query result
+        uint32_t (*QueryRowCount)(const CSVQueryResult* result);
+
+
+        // Get the rows of a query result in order, each is a row number in the csv file
+        // there are QueryRowCount() rows
+        const uint32_t* (*QueryRows)(const CSVQueryResult* result);
+
+
+        // Read a cell of a query result, made to be called from a simpledraw Table callback:
+        // pass the result as the table userdata, QueryRowCount() as the row count, and one
+        // header label for each column in the query
+        // `row` is the row in the result
+        // `column` is the column in the result (an index into CSVQuery.columns)
+        const char* (*QueryCell)(const CSVQueryResult* result, uint32_t row, uint32_t column);
+
+
+        // Free a query result
+        void (*FreeQuery)(CSVQueryResult* result);
+
+
+        // Create (or replace) a csv file and start writing it one cell at a time
+        // cells are collected in a large buffer and written to the file when it fills up
+        // returns NULL if the file cannot be created
+        // `filename` is the name of the csv file, relative to the betterconsole dll like Load
+        // `flush_in_background` write full buffers on a background thread so the caller
+        //                       can keep adding cells while the disk catches up
+        CSVWriter* (*OpenWriter)(const char* filename, bool flush_in_background);
+
+
+        // Write a text cell, the cell is only quoted if it has a comma, quote, or line break
+        void (*WriteCell)(CSVWriter* writer, const char* text);
+
+
+        // Write a number cell, the text is read back exactly by the matching Parse API function
+        void (*WriteU64)(CSVWriter* writer, uint64_t value);
+        void (*WriteS64)(CSVWriter* writer, int64_t value);
+        void (*WriteFloat)(CSVWriter* writer, float value);
+        void (*WriteDouble)(CSVWriter* writer, double value);
+
+
+        // Write a bool cell as 1 or 0 (see ParseBool)
+        void (*WriteBool)(CSVWriter* writer, bool value);
+
+
+        // Finish the current row, the next cell starts a new row
+        void (*EndRow)(CSVWriter* writer);
+
+
+        // Write everything left in the buffer and close the file
+        // returns false if any part of the file could not be written
+        bool (*CloseWriter)(CSVWriter* writer);
+#endif
 };
 
 
@@ -1224,6 +1534,57 @@ struct parse_api_t {
         // NOTE: `out_str` will always be null-terminated
         // NOTE2: if `out_str` is not big enough, this function will still return true
         bool (*ParseStringCSV)(const char* str, char* out, uint32_t out_size);
+
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+        // parse a list of 32-bit unsigned integers such as "1, 2, 3" in one pass
+        // whitespace around each value is ignored, a whitespace delimiter also accepts any run
+        // of whitespace between values
+        // `str` is the null-terminated list to parse
+        // `delimiter` is the character between values
+        // `out_values` receives the parsed values
+        // `max_values` is the size of `out_values`
+        // `as_hex` true to parse the values in hexadecimal (otherwise decimal unless a value starts with 0x)
+        // `out_error_offset` (optional) receives the byte offset in `str` of the first value
+        //                    that could not be parsed or did not fit in `out_values`, or
+        //                    UINT32_MAX if the whole list was parsed
+        // returns the number of values written to `out_values`, parsing stops at the first error
+        // NOTE: unlike ParseU32, values that do not fit in 32 bits are an error instead of being clamped
+        uint32_t (*ParseU32Array)(const char* str, char delimiter, uint32_t* out_values, uint32_t max_values, bool as_hex, uint32_t* out_error_offset);
+
+
+        // parse a list of floats such as "1.5, -2, 3e4" in one pass
+        // works the same as ParseU32Array, values too large for a float are clamped like ParseFloat
+        uint32_t (*ParseFloatArray)(const char* str, char delimiter, float* out_values, uint32_t max_values, uint32_t* out_error_offset);
+
+
+        // write a 64-bit unsigned integer as decimal text
+        // `value` is the number to write
+        // `out` receives the null-terminated text
+        // `out_size` is the size of `out`, 21 bytes always fit
+        // returns the length of the text, or 0 if `out` is too small
+        uint32_t (*FormatU64)(uint64_t value, char* out, uint32_t out_size);
+
+
+        // write a 64-bit signed integer as decimal text
+        // works the same as FormatU64, 21 bytes always fit
+        uint32_t (*FormatS64)(int64_t value, char* out, uint32_t out_size);
+
+
+        // write a float with the fewest digits that ParseFloat reads back as exactly the same value
+        // numbers with more than 21 digits before or 6 zeros after the decimal point are
+        // written in scientific notation ("1e+25", "1.5e-07"), otherwise as plain decimal ("0.1")
+        // infinity and nan are written as "inf", "-inf" and "nan", which do not parse back
+        // `value` is the number to write
+        // `out` receives the null-terminated text
+        // `out_size` is the size of `out`, 32 bytes always fit
+        // returns the length of the text, or 0 if `out` is too small
+        uint32_t (*FormatFloat)(float value, char* out, uint32_t out_size);
+
+
+        // write a double with the fewest digits that ParseDouble reads back as exactly the same value
+        // works the same as FormatFloat, 32 bytes always fit
+        uint32_t (*FormatDouble)(double value, char* out, uint32_t out_size);
+#endif
 };
 
 
@@ -0,0 +1,1019 @@
+#include "config_format.h"
+
+#include "intrinsics.h"
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MODMENU_DEBUG
+#include <chrono>
+#endif
+
+#include "parser.h"
+
+
+static char OutputBuffer[4096];
+static unsigned OutputBufferPos = 0;
+static CONFIG_FLUSH OutputFlush = nullptr;
+static std::string* OutputMemory = nullptr; // when set, output goes here instead of OutputFlush
+
+
+extern void BufferedOutputFlush() {
+        if (OutputMemory) {
+                OutputMemory->append(OutputBuffer, OutputBufferPos);
+        }
+        else {
+                OutputFlush(OutputBuffer, OutputBufferPos);
+        }
+        OutputBufferPos = 0;
+}
+
+// bulk path: copy as much as fits into the output buffer, flush when full, repeat
+extern void BufferedOutputWriteBytes(const char* data, uint32_t size) {
+        while (size) {
+                uint32_t space = sizeof(OutputBuffer) - OutputBufferPos;
+                if (size < space) space = size;
+
+                memcpy(OutputBuffer + OutputBufferPos, data, space);
+                OutputBufferPos += space;
+                data += space;
+                size -= space;
+
+                if (OutputBufferPos == sizeof(OutputBuffer)) {
+                        BufferedOutputFlush();
+                }
+        }
+}
+
+// returns a pointer to at least `min_space` free bytes at the end of the output
+// buffer and the total free space in `out_space`, flushing first if needed
+// follow with BufferedOutputCommit() with the number of bytes actually written
+static inline char* BufferedOutputReserve(uint32_t min_space, uint32_t* out_space) {
+        ASSERT(min_space <= sizeof(OutputBuffer));
+        if ((sizeof(OutputBuffer) - OutputBufferPos) < min_space) {
+                BufferedOutputFlush();
+        }
+        *out_space = sizeof(OutputBuffer) - OutputBufferPos;
+        return OutputBuffer + OutputBufferPos;
+}
+
+static inline void BufferedOutputCommit(uint32_t size) {
+        ASSERT(OutputBufferPos + size <= sizeof(OutputBuffer));
+        OutputBufferPos += size;
+}
+
+extern void BufferedOutputWrite(const char* text) {
+        BufferedOutputWriteBytes(text, (uint32_t)strlen(text));
+}
+
+extern void BufferedOutputStart(CONFIG_FLUSH flush, std::string* memory) {
+        ASSERT((flush != nullptr) || (memory != nullptr));
+        OutputFlush = flush;
+        OutputMemory = memory;
+        OutputBufferPos = 0;
+}
+
+
+extern unsigned char* ConfigParseLines(unsigned char* buffer, unsigned char* begin, std::vector<Setting>* lines) {
+        // a settings file consists of "key ! value" pairs separated by newlines, using '!' makes the parser more efficient
+        // keys are composed of 2 parts: "mod_name : key_name"
+        // this allows different plugins to have the same key_name without collisions
+        // whitespace is trimmed from the left of mod_name and the right of key_name
+        // the settings file is utf8 encoded, should be plain text, and should be human readable / editable
+        // therefore, you should avoid non-printing characters in keys and values even if while the parser doesn't care
+        // newline characters in keys is restricted (will cause parser to ignore line)
+        // any line where the first non-whitespace character is '#' is treated as a comment and is ignored
+        // therefore keys cannot start with the '#' character (parser will treat it as a comment and ignore it)
+        // text in values is quoted and escaped, so newline restrictions and whitespace trimming does not effect values
+        // duplicate keys in the settings file have no guarantees on which one is retrieved during lookup
+        // settings files have a size limit of 4 gigabytes, I truely hope this limit is never reached
+        // memory consumption for the settings is the aligned size of the file + (24 bytes * number_of_keys) + a small overhead
+        // the settings file buffer is only replaced when the file is edited outside of the game and reloaded
+
+
+        enum token_type : unsigned char {
+                TT_NONE = 0,
+                TT_NULL,
+                TT_NEWLINE,
+                TT_EXCLAIM,
+        };
+
+        // lookup table for the parser
+        // the only characters the parser cares about are NULL '\0', newline '\n', and exclaimation mark '!'
+        // using some smart (or cursed) programming, the lookup table for the parser can be significantly
+        // smaller than the 256 possible bytes it could encounter
+        // the following parser state is only 64 bytes and should fit into a single cpu cache line
+        unsigned char lookup[40];
+        unsigned char* f = begin - 1; //yep, this is initialized to a value outside the array (or the previous line's newline)
+        unsigned char* expos = nullptr; //the position of the exclaimation mark on the current line
+        unsigned char* lastlf = f; //last line feed '\n', initialization out of bounds also intentional
+        memset(lookup, TT_NONE, sizeof(lookup));
+        lookup[0] = TT_NULL;
+        lookup['\n'] = TT_NEWLINE;
+        lookup['!'] = TT_EXCLAIM;
+
+        for (;;) { //yep, this loop is endless, that makes the branch predictor happy
+                ++f;
+
+                const unsigned char c = *f;
+
+                // the most common case (>80% of standard utf8 text)
+                // since the only characters the parser cares about are <= '!'
+                // this tight loop in the first branch makes the predictor very happy
+                // you might wonder why '!' is the most efficient character for this
+                // at 0x21 its the first non-whitespace printable utf8 character
+                if (c > '!') continue;
+
+                const auto t = lookup[c]; //we know c must be in bounds of the array
+
+                // the next most common case would be space ' ' (>80% of remaining characters)
+                // or another character the parser does not need to care about
+                if (!t) continue;
+
+                // we are down to only 3 possible options: TT_NULL, TT_NEWLINE, and TT_EXCLAIM
+                // considering that comment lines are a thing then newline would be more 
+                // common than the '!' character, so check that first
+                if (t == TT_NEWLINE) {
+                        // the parser found a newline character
+                        // this is where we actually try to parse the line
+                        // remove whitespace, etc...
+                        // we know where the last newline was `lastlf`
+                        // we also know if an exclaimation was found `expos`
+                        // we know where the current line ends `f`
+                        // we can determine where the keys and values are using only this info
+                        unsigned char* keypos = lastlf;
+                        lastlf = f;
+
+                        if (!expos) continue; // no '!'? then there can't be a key!value pair 
+
+                        unsigned char* valpos = expos;
+                        expos = nullptr;
+
+                        //step 1: advance keypos until the first non-whitespace character (left-trim)
+                        do {
+                                // on first iteration, unconditionally advance past keypos (lastlf)
+                                // which we know cannot be part of this line's key
+                                ++keypos;
+                        } while (::isspace(*keypos));
+
+                        if (keypos == valpos) continue; //key was empty
+
+                        if (*keypos == '#') continue; //this is a comment line, ignore
+
+                        //step 2: key is not empty, so trim space on the right
+                        unsigned char* null_maker = valpos;
+                        do {
+                                // on the first iteration, null out the '!' character unconditionally
+                                *null_maker = 0; 
+                                --null_maker;
+                        } while (::isspace(*null_maker));
+
+                        //keypos is now null terminated, not empty, and trimmed
+
+                        //Step 4: right trim the value
+                        null_maker = f;
+                        do {
+                                // on the first iteration, null out the newline '\n' character unconditionally
+                                *null_maker = 0;
+                                --null_maker;
+                        } while (::isspace(*null_maker));
+
+                        if (null_maker == valpos) continue; //value was empty
+
+                        //step 5: left trim the value
+                        do {
+                                //on the first iteration, advance past the (now null) '!' character unconditionally
+                                ++valpos; 
+                        } while (::isspace(*valpos));
+
+                        //valpos is now null terminated, not empty, and trimmed
+
+                        // finally, insert the key and value into the array
+                        // the value is not actually parsed until something
+                        // tries to read the key, so the parse time is also lower
+                        Setting s{};
+                        s.key_hash = hash_fnv1a((const char*)keypos);
+                        s.key_offset = (uint32_t)(keypos - buffer);
+                        s.value_offset = (uint32_t)(valpos - buffer);
+                        lines->push_back(s);
+                        // a fun excerise is that now would be the perfect time
+                        // for a parser in another thread to transform the value in-place
+                        // values are escaped or otherwise encoded in the config file
+                        // and we could unescape or decode it while this thread continues to parse
+                        // the config file, heck we could even perform the fnv1a hash on the
+                        // other thread too, which would very evenly split the amount of work
+                        // nearly in half, im not sure any other parser out there could do that
+                        // due to our format being so simple. but for now, we just leave it as-is
+                        continue;
+                }
+
+                // we are down to only 2 possible options: TT_EXCLAIM or TT_NULL
+                // TT_EXCLAIM is the most common as we would only parse TT_NULL once
+                // in the entire file, then terminate the parser loop
+                if (t == TT_EXCLAIM) {
+                        expos = f;
+                        continue;
+                }
+
+                // the only other option is the terminating condition: TT_NULL
+                // if control flow reaches here we terminate the loop unconditionally
+                // no need to even check if the current token is TT_NULL
+                // in fact, we dont actually check for a null at all anywhere in the parser
+                // we just kind of deduce a null by the process of elimination
+                // i dont really see other parsers out there that would do that
+                // usually most hand written parsers would start off with a for loop like:
+                // for (char *cur = buffer; (*cur && (cur != buffer_end)); ++cur)
+                // or:
+                // for (size_t i = 0; buffer[i] && (i < buffer_size); ++i)
+                // but we eliminated the need for both of those conditions
+                return f;
+        }
+}
+
+
+// `lines` must be sorted by hash, the result points into `lines`
+extern Setting* ConfigFindKey(std::vector<Setting>& lines, const unsigned char* buffer, const char* mod_name, const char* key_name) {
+        ASSERT(mod_name);
+        char key_buffer[128];
+        snprintf(key_buffer, sizeof(key_buffer), "%s:%s", mod_name, key_name);
+        const auto hash = hash_fnv1a(key_buffer);
+
+        auto range = std::equal_range(lines.begin(), lines.end(), hash);
+
+        for (auto& i = range.first; i != range.second; i++) {
+                if (strncmp((const char*)buffer + i->key_offset, key_buffer, sizeof(key_buffer)) == 0) {
+                        return &*i;
+                }
+        }
+
+        return nullptr;
+}
+
+
+extern void ConfigWriteKeyText(const char* mod_name, const char* key_name) {
+        BufferedOutputWrite(mod_name);
+        BufferedOutputWrite(":");
+        BufferedOutputWrite(key_name);
+        BufferedOutputWrite("!");
+}
+
+
+extern void ConfigWriteU32Value(uint32_t value) {
+        char fmt[32];
+        const uint32_t length = FormatU64(value, fmt, sizeof(fmt) - 1);
+        memcpy(fmt + length, "\n", 2);
+        BufferedOutputWriteBytes(fmt, length + 1);
+}
+
+
+extern void ConfigWriteFloatValue(float value) {
+        // the shortest text that reads back as the same float, "%f" lost small values
+        char fmt[40];
+        const uint32_t length = FormatFloat(value, fmt, sizeof(fmt) - 1);
+        memcpy(fmt + length, "\n", 2);
+        BufferedOutputWriteBytes(fmt, length + 1);
+}
+
+
+extern void ConfigWriteBoolValue(bool value) {
+        BufferedOutputWriteBytes((value) ? "1\n" : "0\n", 2);
+}
+
+
+// find the next character in `str` that needs special handling by the string codec
+// when `escaping` is true that is any of: null, backslash, newline, exclaimation mark, quote
+// otherwise (unescaping) that is any of: null, backslash, quote
+// 16 bytes are tested at a time, the loads are aligned so they never cross into
+// the next page even if they read past the null terminator
+static inline NO_SANITIZE_ADDRESS const char* ConfigFindSpecialChar(const char* str, bool escaping) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i newline = _mm_set1_epi8((escaping) ? '\n' : 0);
+        const __m128i exclaim = _mm_set1_epi8((escaping) ? '!' : 0);
+
+        const auto misalign = (unsigned)((uintptr_t)str & 15);
+        const char* p = str - misalign;
+        unsigned mask = 0xFFFFu << misalign; //ignore the bytes before str in the first block
+
+        for (;;) {
+                const __m128i block = _mm_load_si128((const __m128i*)p);
+                __m128i special = _mm_cmpeq_epi8(block, zero);
+                special = _mm_or_si128(special, _mm_cmpeq_epi8(block, backslash));
+                special = _mm_or_si128(special, _mm_cmpeq_epi8(block, quote));
+                special = _mm_or_si128(special, _mm_cmpeq_epi8(block, newline));
+                special = _mm_or_si128(special, _mm_cmpeq_epi8(block, exclaim));
+                mask &= (unsigned)_mm_movemask_epi8(special);
+
+                if (mask) {
+                        unsigned long bit;
+                        _BitScanForward(&bit, mask);
+                        return p + bit;
+                }
+
+                p += 16;
+                mask = 0xFFFFu;
+        }
+}
+
+
+extern bool ConfigReadEscapedString(const char* in_value, char* out, uint32_t out_size, uint32_t* out_length) {
+        const char* v = in_value;
+        const uint32_t max_len = out_size - 1;
+        uint32_t pos = 0;
+        bool is_plain = true;
+
+        // we use a quote at the front of the string
+        // to prevent the whitespace trimmer in the
+        // parser from interfering
+        if (*v == '\"') ++v;
+
+        // copy spans of plain text in bulk and only
+        // decode escape sequences where they are found
+        for (;;) {
+                const char* const special = ConfigFindSpecialChar(v, false);
+
+                uint32_t span = (uint32_t)(special - v);
+                if (span > max_len - pos) span = max_len - pos;
+                memcpy(out + pos, v, span);
+                pos += span;
+
+                // found the terminating quote / null
+                if (*special != '\\') {
+                        is_plain &= (span == (uint32_t)(special - v));
+                        break;
+                }
+
+                // the cached fast path can only copy values without escape sequences
+                is_plain = false;
+                if (pos == max_len) break; //out of space
+
+                char outchar = 0;
+                switch (special[1])
+                {
+                        // the parser only cares about certain characters
+                        // so only need to handle those
+                case '0': outchar = 0;
+                        break;
+                case 'n': outchar = '\n';
+                        break;
+                case 'e': outchar = '!';
+                        break;
+                case '\\': outchar = '\\';
+                        break;
+                case '"': outchar = '"';
+                        break;
+                default:
+                        //invalid escape sequence
+                        outchar = 0;
+                }
+
+                if (!outchar) break;
+                out[pos++] = outchar;
+                v = special + 2;
+        }
+
+        //ensure null termination
+        out[pos] = 0;
+        *out_length = pos;
+        return is_plain;
+}
+
+
+extern void ConfigWriteStringValue(const char *in_unescaped_string) {
+        const char* in = in_unescaped_string;
+
+        //so that parser doesnt trim whitespace unintentionally
+        BufferedOutputWriteBytes("\"", 1);
+
+        // copy spans of plain text in bulk and only
+        // encode escape sequences where they are needed
+        for (;;) {
+                const char* const special = ConfigFindSpecialChar(in, true);
+                BufferedOutputWriteBytes(in, (uint32_t)(special - in));
+
+                char escape[2] = { '\\', *special };
+                if (escape[1] == 0) break;
+                else if (escape[1] == '\n') escape[1] = 'n';
+                else if (escape[1] == '!') escape[1] = 'e';
+
+                BufferedOutputWriteBytes(escape, sizeof(escape));
+                in = special + 1;
+        }
+
+        // insert escape sequence so that the parser doesnt
+        // trim whitespace unintentionally
+        BufferedOutputWriteBytes("\"\n", 2);
+}
+
+
+// blobs are stored hex encoded by default, or base64 encoded with this prefix
+// when the user enables "Store Config Data As Base64", reading accepts either
+#define CONFIG_DATA_BASE64_PREFIX "base64:"
+
+static const char Base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+// 16 bytes of input become 32 hex characters per iteration
+static void HexEncode(const unsigned char* in, uint32_t size, char* out) {
+        const __m128i low_nibble = _mm_set1_epi8(0x0F);
+        const __m128i nine = _mm_set1_epi8(9);
+        const __m128i ascii_zero = _mm_set1_epi8('0');
+        const __m128i letter_offset = _mm_set1_epi8('A' - '0' - 10);
+
+        uint32_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+                const __m128i bytes = _mm_loadu_si128((const __m128i*)(in + i));
+                const __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), low_nibble);
+                const __m128i lo = _mm_and_si128(bytes, low_nibble);
+
+                // the high nibble comes first in the text
+                __m128i a = _mm_unpacklo_epi8(hi, lo);
+                __m128i b = _mm_unpackhi_epi8(hi, lo);
+
+                // nibble -> '0'-'9' or 'A'-'F'
+                a = _mm_add_epi8(_mm_add_epi8(a, ascii_zero), _mm_and_si128(_mm_cmpgt_epi8(a, nine), letter_offset));
+                b = _mm_add_epi8(_mm_add_epi8(b, ascii_zero), _mm_and_si128(_mm_cmpgt_epi8(b, nine), letter_offset));
+
+                _mm_storeu_si128((__m128i*)(out + (i * 2)), a);
+                _mm_storeu_si128((__m128i*)(out + (i * 2) + 16), b);
+        }
+
+        static const char* const hex{ "0123456789ABCDEF" };
+        for (; i < size; ++i) {
+                out[(i * 2)] = hex[in[i] >> 4];
+                out[(i * 2) + 1] = hex[in[i] & 0xF];
+        }
+}
+
+
+// 32 hex characters become 16 bytes per iteration
+// `in` must have exactly `size * 2` readable characters
+// returns false if any non-hex characters were found
+static bool HexDecode(const char* in, unsigned char* out, uint32_t size) {
+        const __m128i case_bit = _mm_set1_epi8(0x20);
+        const __m128i ascii_zero = _mm_set1_epi8('0');
+        const __m128i ascii_a = _mm_set1_epi8('a');
+        const __m128i nine = _mm_set1_epi8(9);
+        const __m128i five = _mm_set1_epi8(5);
+        const __m128i ten = _mm_set1_epi8(10);
+        const __m128i low_byte = _mm_set1_epi16(0x00FF);
+
+        // convert 16 hex characters to 16 nibbles, clears `valid` if any character is not hex
+        const auto to_nibbles = [&](__m128i c, bool& valid) -> __m128i {
+                const __m128i digit = _mm_sub_epi8(c, ascii_zero);
+                const __m128i letter = _mm_sub_epi8(_mm_or_si128(c, case_bit), ascii_a);
+                // unsigned compare (x <= n) as (max(x, n) == n)
+                const __m128i is_digit = _mm_cmpeq_epi8(_mm_max_epu8(digit, nine), nine);
+                const __m128i is_letter = _mm_cmpeq_epi8(_mm_max_epu8(letter, five), five);
+                valid &= (_mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) == 0xFFFF);
+                return _mm_or_si128(_mm_and_si128(digit, is_digit), _mm_and_si128(_mm_add_epi8(letter, ten), is_letter));
+        };
+
+        // pairs of nibbles {hi, lo} viewed as 16-bit lanes become bytes (hi << 4 | lo)
+        const auto to_bytes = [&](__m128i n) -> __m128i {
+                return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(n, low_byte), 4), _mm_srli_epi16(n, 8));
+        };
+
+        bool valid = true;
+        uint32_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+                const __m128i a = to_nibbles(_mm_loadu_si128((const __m128i*)(in + (i * 2))), valid);
+                const __m128i b = to_nibbles(_mm_loadu_si128((const __m128i*)(in + (i * 2) + 16)), valid);
+                _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(to_bytes(a), to_bytes(b)));
+        }
+        if (!valid) return false;
+
+        for (; i < size; ++i) {
+                unsigned char v[2];
+                for (unsigned j = 0; j < 2; ++j) {
+                        const unsigned char c = (unsigned char)in[(i * 2) + j];
+                        if ((c >= '0') && (c <= '9')) v[j] = c - '0';
+                        else if (((c | 0x20) >= 'a') && ((c | 0x20) <= 'f')) v[j] = (c | 0x20) - 'a' + 10;
+                        else return false;
+                }
+                out[i] = (unsigned char)((v[0] << 4) | v[1]);
+        }
+
+        return true;
+}
+
+
+// encode complete groups of 3 bytes into 4 characters,
+// the final 1 or 2 bytes are padded with '='
+// when streaming, only the last chunk may end with a partial group
+static uint32_t Base64Encode(const unsigned char* in, uint32_t size, char* out) {
+        char* o = out;
+        uint32_t i = 0;
+        for (; i + 3 <= size; i += 3) {
+                const uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+                *o++ = Base64Chars[(v >> 18) & 63];
+                *o++ = Base64Chars[(v >> 12) & 63];
+                *o++ = Base64Chars[(v >> 6) & 63];
+                *o++ = Base64Chars[v & 63];
+        }
+
+        const auto remain = size - i;
+        if (remain) {
+                const uint32_t v = (in[i] << 16) | ((remain == 2) ? (in[i + 1] << 8) : 0);
+                *o++ = Base64Chars[(v >> 18) & 63];
+                *o++ = Base64Chars[(v >> 12) & 63];
+                *o++ = (remain == 2) ? Base64Chars[(v >> 6) & 63] : '=';
+                *o++ = '=';
+        }
+
+        return (uint32_t)(o - out);
+}
+
+
+// `in` must have exactly the number of characters that `size` bytes encodes to
+// returns false if any non-base64 characters were found or the text is not
+// exactly what Base64Encode() writes for the decoded bytes
+static bool Base64Decode(const char* in, unsigned char* out, uint32_t size) {
+        // the index of each character in Base64Chars, 255 is an invalid character
+        // '=' is only accepted where padding is expected
+        static constexpr unsigned char lookup[256] = {
+                255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+                255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+                255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,  62, 255, 255, 255,  63,
+                 52,  53,  54,  55,  56,  57,  58,  59,  60,  61, 255, 255, 255, 255, 255, 255,
+                255,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+                 15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, 255, 255, 255, 255, 255,
+                255,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
+                 41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51, 255, 255, 255, 255, 255,
+                255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+                255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+                255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+                255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+                255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+                255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+                255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+                255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        };
+
+        const auto* s = (const unsigned char*)in;
+        uint32_t i = 0;
+        for (; i + 3 <= size; i += 3, s += 4) {
+                const uint32_t a = lookup[s[0]], b = lookup[s[1]], c = lookup[s[2]], d = lookup[s[3]];
+                if ((a | b | c | d) & 192) return false;
+                const uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+                out[i] = (unsigned char)(v >> 16);
+                out[i + 1] = (unsigned char)(v >> 8);
+                out[i + 2] = (unsigned char)v;
+        }
+
+        const auto remain = size - i;
+        if (remain) {
+                const uint32_t a = lookup[s[0]], b = lookup[s[1]];
+                const uint32_t c = (remain == 2) ? lookup[s[2]] : ((s[2] == '=') ? 0 : 255);
+                if (((a | b | c) & 192) || (s[3] != '=')) return false;
+                // the bits after the last byte must be zero, otherwise more than
+                // one text would decode to the same data
+                if ((remain == 1) ? (b & 15) : (c & 3)) return false;
+                const uint32_t v = (a << 18) | (b << 12) | (c << 6);
+                out[i] = (unsigned char)(v >> 16);
+                if (remain == 2) out[i + 1] = (unsigned char)(v >> 8);
+        }
+
+        return true;
+}
+
+
+extern bool ConfigReadData(const char* in_data, char* out_buffer, uint32_t buffer_size) {
+        const auto prefix_len = sizeof(CONFIG_DATA_BASE64_PREFIX) - 1;
+        const bool is_base64 = (strncmp(in_data, CONFIG_DATA_BASE64_PREFIX, prefix_len) == 0);
+        if (is_base64) in_data += prefix_len;
+
+        // checking the length up front means the decoders never read past the value
+        const size_t expected = (is_base64) ? ((buffer_size + 2ULL) / 3) * 4 : buffer_size * 2ULL;
+        if (strlen(in_data) != expected) return false;
+
+        return (is_base64) ?
+                Base64Decode(in_data, (unsigned char*)out_buffer, buffer_size) :
+                HexDecode(in_data, (unsigned char*)out_buffer, buffer_size);
+}
+
+
+// blobs are encoded straight into the output buffer a chunk at a time
+// so they can be much larger than the output buffer itself
+extern void ConfigWriteDataValue(const void* in_data, uint32_t data_size, bool as_base64) {
+        auto in = (const unsigned char*)in_data;
+
+        if (as_base64) {
+                BufferedOutputWrite(CONFIG_DATA_BASE64_PREFIX);
+        }
+
+        while (data_size) {
+                uint32_t space;
+                char* const out = BufferedOutputReserve(4, &space);
+
+                uint32_t bytes = (as_base64) ? (space / 4) * 3 : space / 2;
+                if (bytes > data_size) bytes = data_size;
+
+                if (as_base64) {
+                        BufferedOutputCommit(Base64Encode(in, bytes, out));
+                }
+                else {
+                        HexEncode(in, bytes, out);
+                        BufferedOutputCommit(bytes * 2);
+                }
+
+                in += bytes;
+                data_size -= bytes;
+        }
+        BufferedOutputWrite("\n");
+}
+
+
+#ifdef MODMENU_DEBUG
+// debug only: measure the writer, loader, and lookups on generated settings text from
+// 1K to 1M keys, write random keys and values of every type and check that the parser
+// reads back exactly what was written, round trip and time the data codecs, then throw random bytes at the parser and check
+// every setting it finds is inside the buffer. everything stays in memory and the buffers
+// are allocated at their exact size, so tools/harness.cpp can run this under AddressSanitizer
+// the settings benchmark (F3) runs this with the writer lock held
+extern void ConfigFormatBenchmark() {
+        const auto Parser = GetParserAPI();
+
+        uint64_t rng = 0x2545F4914F6CDD1D;
+        const auto random = [&]() -> uint32_t {
+                rng ^= rng << 13;
+                rng ^= rng >> 7;
+                rng ^= rng << 17;
+                return (uint32_t)(rng >> 32);
+        };
+
+        using clock = std::chrono::steady_clock;
+        const auto now = []() -> clock::time_point {
+                return clock::now();
+        };
+        const auto seconds = [&](clock::time_point start) -> double {
+                return std::chrono::duration<double>(now() - start).count();
+        };
+
+        // the file as ConfigReadFile() leaves it: a newline and a null after the text,
+        // but nothing else, so a read past the end is caught by the sanitizer
+        const auto load = [](const std::string& text, std::vector<Setting>* lines) -> unsigned char* {
+                const auto buffer = (unsigned char*)malloc(text.size() + 2);
+                ASSERT(buffer != NULL);
+                memcpy(buffer, text.data(), text.size());
+                buffer[text.size()] = '\n';
+                buffer[text.size() + 1] = 0;
+                lines->clear();
+                ConfigParseLines(buffer, buffer, lines);
+                std::sort(lines->begin(), lines->end());
+                return buffer;
+        };
+
+        // values are written by the real writer so they need characters the codec escapes
+        static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-.,:#!\"\\\n\t\xC3\xA9";
+
+        std::string text;
+        std::vector<Setting> lines;
+
+        for (uint32_t key_count = 1000; key_count <= 1000000; key_count *= 10) {
+                struct BenchKey {
+                        char mod[24];
+                        char key[48];
+                        char value[48];
+                };
+                std::vector<BenchKey> keys;
+                keys.resize(key_count);
+                for (uint32_t i = 0; i < key_count; ++i) {
+                        auto& k = keys[i];
+                        snprintf(k.mod, sizeof(k.mod), "BenchmarkMod%u", i / 500);
+                        const auto len = snprintf(k.key, sizeof(k.key), "Setting %u ", i);
+                        const auto extra = 4 + random() % 24;
+                        for (uint32_t j = 0; j < extra; ++j) k.key[len + j] = 'a' + random() % 26;
+                        k.key[len + extra] = 0;
+                        if (i & 1) {
+                                snprintf(k.value, sizeof(k.value), "%u", random());
+                        }
+                        else {
+                                const auto vlen = random() % (sizeof(k.value) - 1);
+                                for (uint32_t j = 0; j < vlen; ++j) k.value[j] = alphabet[random() % (sizeof(alphabet) - 1)];
+                                k.value[vlen] = 0;
+                        }
+                }
+
+                // save
+                text.clear();
+                auto start = now();
+                BufferedOutputStart(nullptr, &text);
+                for (uint32_t i = 0; i < key_count; ++i) {
+                        const auto& k = keys[i];
+                        if ((i % 500) == 0) {
+                                BufferedOutputWrite("# a comment line that the parser has to skip\n");
+                        }
+                        ConfigWriteKeyText(k.mod, k.key);
+                        if (i & 1) {
+                                ConfigWriteU32Value(strtoul(k.value, nullptr, 10));
+                        }
+                        else {
+                                ConfigWriteStringValue(k.value);
+                        }
+                }
+                BufferedOutputFlush();
+                const auto save_time = seconds(start);
+
+                // load
+                start = now();
+                const auto buffer = load(text, &lines);
+                const auto load_time = seconds(start);
+                const auto megabytes = text.size() / (1024. * 1024.);
+
+                uint32_t errors = 0;
+                start = now();
+                for (uint32_t i = 0; i < key_count; ++i) {
+                        if (!ConfigFindKey(lines, buffer, keys[i].mod, keys[i].key)) ++errors;
+                }
+                const auto hit_time = seconds(start);
+
+                start = now();
+                for (uint32_t i = 0; i < key_count; ++i) {
+                        keys[i].key[0] = 's'; //not in the file
+                        if (ConfigFindKey(lines, buffer, keys[i].mod, keys[i].key)) ++errors;
+                        keys[i].key[0] = 'S';
+                }
+                const auto miss_time = seconds(start);
+
+                // every hit is checked against the value that was written
+                for (uint32_t i = 0; i < key_count; ++i) {
+                        const auto setting = ConfigFindKey(lines, buffer, keys[i].mod, keys[i].key);
+                        if (!setting) continue;
+                        const auto stored = (const char*)buffer + setting->value_offset;
+                        char value[sizeof(keys[i].value)];
+                        uint32_t length;
+                        if (i & 1) {
+                                snprintf(value, sizeof(value), "%s", stored);
+                        }
+                        else {
+                                ConfigReadEscapedString(stored, value, sizeof(value), &length);
+                        }
+                        if (strcmp(value, keys[i].value)) {
+                                DEBUG("Round trip failed for '%s:%s'", keys[i].mod, keys[i].key);
+                                ++errors;
+                        }
+                }
+
+                DEBUG("Settings benchmark, %u keys %.2f MB: save %.1f MB/s, load %.1f MB/s, lookup hit %.1f ns, miss %.1f ns, %u errors",
+                        key_count, megabytes, megabytes / save_time, megabytes / load_time,
+                        hit_time * 1e9 / key_count, miss_time * 1e9 / key_count, errors);
+                free(buffer);
+        }
+
+        // writer -> parser round trip: random mod and key names, and random values of
+        // every type, must read back exactly as they were written
+        enum FuzzType : uint32_t { FT_U32, FT_Float, FT_Bool, FT_String, FT_Data, FT_COUNT };
+        struct FuzzKey {
+                char mod[16];
+                char key[64];
+                FuzzType type;
+                uint32_t bits; // u32, float bits, or bool
+                bool as_base64;
+                std::string bytes; // string or data
+        };
+        // anything but the characters the parser splits on, names are trimmed so they
+        // never start or end with whitespace, and a mod name can not start with '#'
+        const auto random_name = [&](char* out, uint32_t size, bool is_mod) {
+                const auto length = 1 + random() % (size - 1);
+                for (uint32_t i = 0; i < length; ++i) {
+                        unsigned char c;
+                        do {
+                                c = (random() & 3) ? (unsigned char)(' ' + random() % 95) : (unsigned char)random();
+                        } while (!c || (c == '\n') || (c == '!') || (is_mod && (c == ':')) || (((i == 0) || (i == length - 1)) && ::isspace(c)));
+                        out[i] = (char)c;
+                }
+                if (is_mod && (out[0] == '#')) out[0] = 'm';
+                out[length] = 0;
+        };
+
+        uint32_t round_trip_errors = 0;
+        uint32_t round_trip_keys = 0;
+        std::vector<FuzzKey> fuzz_keys;
+        for (uint32_t iteration = 0; iteration < 200; ++iteration) {
+                fuzz_keys.resize(1 + random() % 64);
+                for (uint32_t i = 0; i < fuzz_keys.size(); ++i) {
+                        auto& k = fuzz_keys[i];
+                        random_name(k.mod, sizeof(k.mod), true);
+                        // keys are unique, duplicates have no guarantee which one is found
+                        char name[48];
+                        random_name(name, sizeof(name), false);
+                        snprintf(k.key, sizeof(k.key), "%u%s", i, name);
+                        k.type = (FuzzType)(random() % FT_COUNT);
+                        k.bits = random();
+                        k.as_base64 = (random() & 1);
+                        k.bytes.clear();
+                        if (k.type == FT_Float) {
+                                while (((k.bits >> 23) & 0xFF) == 0xFF) k.bits = random(); //no inf or nan
+                        }
+                        else if (k.type == FT_Bool) {
+                                k.bits &= 1;
+                        }
+                        else if (k.type == FT_String) {
+                                const auto length = random() % 200;
+                                for (uint32_t j = 0; j < length; ++j) {
+                                        const auto c = (char)(1 + random() % 255);
+                                        k.bytes.push_back((random() & 1) ? c : alphabet[random() % (sizeof(alphabet) - 1)]);
+                                }
+                        }
+                        else if (k.type == FT_Data) {
+                                const auto size = 1 + random() % 200;
+                                for (uint32_t j = 0; j < size; ++j) k.bytes.push_back((char)random());
+                        }
+                }
+
+                text.clear();
+                BufferedOutputStart(nullptr, &text);
+                for (const auto& k : fuzz_keys) {
+                        ConfigWriteKeyText(k.mod, k.key);
+                        switch (k.type) {
+                        case FT_U32: ConfigWriteU32Value(k.bits);
+                                break;
+                        case FT_Float: {
+                                float f;
+                                memcpy(&f, &k.bits, sizeof(f));
+                                ConfigWriteFloatValue(f);
+                                break;
+                        }
+                        case FT_Bool: ConfigWriteBoolValue(k.bits != 0);
+                                break;
+                        case FT_String: ConfigWriteStringValue(k.bytes.c_str());
+                                break;
+                        default: ConfigWriteDataValue(k.bytes.data(), (uint32_t)k.bytes.size(), k.as_base64);
+                        }
+                }
+                BufferedOutputFlush();
+
+                const auto buffer = load(text, &lines);
+                if (lines.size() != fuzz_keys.size()) {
+                        DEBUG("Round trip found %u settings, wrote %u", (unsigned)lines.size(), (unsigned)fuzz_keys.size());
+                        ++round_trip_errors;
+                }
+                for (const auto& k : fuzz_keys) {
+                        ++round_trip_keys;
+                        const auto setting = ConfigFindKey(lines, buffer, k.mod, k.key);
+                        if (!setting) {
+                                DEBUG("Round trip lost the key '%s:%s'", k.mod, k.key);
+                                ++round_trip_errors;
+                                continue;
+                        }
+                        const auto stored = (const char*)buffer + setting->value_offset;
+                        bool ok = false;
+                        if (k.type == FT_U32) {
+                                uint32_t value;
+                                ok = Parser->ParseU32(stored, &value, false) && (value == k.bits);
+                        }
+                        else if (k.type == FT_Float) {
+                                float value;
+                                ok = Parser->ParseFloat(stored, &value) && !memcmp(&value, &k.bits, sizeof(value));
+                        }
+                        else if (k.type == FT_Bool) {
+                                ok = ((*stored == '1') == (k.bits != 0));
+                        }
+                        else if (k.type == FT_String) {
+                                char value[256];
+                                uint32_t length;
+                                ConfigReadEscapedString(stored, value, sizeof(value), &length);
+                                ok = (length == k.bytes.size()) && !memcmp(value, k.bytes.data(), length);
+                        }
+                        else {
+                                char value[200];
+                                ok = ConfigReadData(stored, value, (uint32_t)k.bytes.size()) && !memcmp(value, k.bytes.data(), k.bytes.size());
+                        }
+                        if (!ok) {
+                                DEBUG("Round trip changed the value of '%s:%s': '%s'", k.mod, k.key, stored);
+                                ++round_trip_errors;
+                        }
+                }
+                free(buffer);
+        }
+        DEBUG("Settings writer round trip: %u keys, %u errors", round_trip_keys, round_trip_errors);
+
+        // the data codecs: every size from empty to a few blocks past the 16 byte
+        // vector loops, hex and base64, must decode to the bytes that were encoded.
+        // a changed character must either be rejected or decode to different bytes,
+        // and base64 with non-zero bits after the last byte must be rejected
+        uint32_t codec_errors = 0;
+        std::vector<unsigned char> data, decoded;
+        std::string encoded;
+        const auto encode = [&](const unsigned char* in, uint32_t size, bool as_base64) {
+                encoded.resize((as_base64) ? (sizeof(CONFIG_DATA_BASE64_PREFIX) - 1) + ((size + 2) / 3) * 4 : size * 2);
+                if (as_base64) {
+                        memcpy(&encoded[0], CONFIG_DATA_BASE64_PREFIX, sizeof(CONFIG_DATA_BASE64_PREFIX) - 1);
+                        Base64Encode(in, size, &encoded[sizeof(CONFIG_DATA_BASE64_PREFIX) - 1]);
+                }
+                else if (size) {
+                        HexEncode(in, size, &encoded[0]);
+                }
+        };
+        // the decoders only see a null terminated copy of exactly the encoded text
+        const auto decode = [&](const std::string& text, uint32_t size) -> bool {
+                const auto copy = (char*)malloc(text.size() + 1);
+                ASSERT(copy != NULL);
+                memcpy(copy, text.data(), text.size());
+                copy[text.size()] = 0;
+                decoded.resize(size + 1);
+                const bool ok = ConfigReadData(copy, (char*)decoded.data(), size);
+                free(copy);
+                return ok;
+        };
+        for (uint32_t iteration = 0; iteration < 20000; ++iteration) {
+                const uint32_t size = (iteration < 200) ? iteration / 2 : random() % 1024;
+                const bool as_base64 = (iteration & 1);
+                data.resize(size + 1);
+                for (uint32_t i = 0; i < size; ++i) data[i] = (unsigned char)random();
+
+                encode(data.data(), size, as_base64);
+                if (!decode(encoded, size) || memcmp(decoded.data(), data.data(), size)) {
+                        DEBUG("Data round trip failed, %u bytes as %s", size, (as_base64) ? "base64" : "hex");
+                        ++codec_errors;
+                }
+                if (!size) continue;
+
+                const auto prefix = (as_base64) ? sizeof(CONFIG_DATA_BASE64_PREFIX) - 1 : 0;
+                const auto changed = prefix + random() % (encoded.size() - prefix);
+                const auto original = encoded[changed];
+                encoded[changed] = (char)random();
+                // hex is read in either case, only base64 is case sensitive
+                const bool same = (as_base64) ? (encoded[changed] == original) : (::tolower((unsigned char)encoded[changed]) == ::tolower((unsigned char)original));
+                if (!same && decode(encoded, size) && !memcmp(decoded.data(), data.data(), size)) {
+                        DEBUG("A changed %s character decoded to the same data", (as_base64) ? "base64" : "hex");
+                        ++codec_errors;
+                }
+                encoded[changed] = original;
+
+                // the padding is 1 or 2 '=', the character before it carries the unused bits
+                if (as_base64 && (size % 3)) {
+                        const auto last = encoded.size() - ((size % 3 == 1) ? 3 : 2);
+                        const auto value = strchr(Base64Chars, encoded[last]) - Base64Chars;
+                        encoded[last] = Base64Chars[value | ((size % 3 == 1) ? 1 + random() % 15 : 1 + random() % 3)];
+                        if (decode(encoded, size)) {
+                                DEBUG("Non-canonical base64 was accepted, %u bytes", size);
+                                ++codec_errors;
+                        }
+                }
+        }
+        DEBUG("Settings data round trip: 20000 values, %u errors", codec_errors);
+
+        {
+                const uint32_t size = 16 * 1024 * 1024;
+                data.resize(size);
+                for (uint32_t i = 0; i < size; ++i) data[i] = (unsigned char)random();
+                const auto megabytes = size / (1024. * 1024.);
+
+                auto start = now();
+                encode(data.data(), size, false);
+                const auto hex_encode_time = seconds(start);
+                start = now();
+                const bool hex_ok = decode(encoded, size) && !memcmp(decoded.data(), data.data(), size);
+                const auto hex_decode_time = seconds(start);
+
+                start = now();
+                encode(data.data(), size, true);
+                const auto base64_encode_time = seconds(start);
+                start = now();
+                const bool base64_ok = decode(encoded, size) && !memcmp(decoded.data(), data.data(), size);
+                const auto base64_decode_time = seconds(start);
+
+                DEBUG("Settings data codecs, 16 MB: hex encode %.1f MB/s, decode %.1f MB/s, base64 encode %.1f MB/s, decode %.1f MB/s%s",
+                        megabytes / hex_encode_time, megabytes / hex_decode_time,
+                        megabytes / base64_encode_time, megabytes / base64_decode_time,
+                        (hex_ok && base64_ok) ? "" : ", ROUND TRIP FAILED");
+        }
+
+        // the parser only stops at the null terminator, so garbage in the
+        // file must never produce a key or value outside of the buffer
+        uint32_t fuzz_errors = 0;
+        static const char fuzz_chars[] = "ab:!# \t\r\n\"\\";
+        for (uint32_t iteration = 0; iteration < 20000; ++iteration) {
+                const auto size = random() % 512;
+                text.resize(size);
+                for (uint32_t i = 0; i < size; ++i) {
+                        text[i] = (random() & 7) ? fuzz_chars[random() % (sizeof(fuzz_chars) - 1)] : (char)random();
+                }
+
+                const auto buffer = load(text, &lines);
+                for (const auto& line : lines) {
+                        const auto key = (const char*)buffer + line.key_offset;
+                        const auto value = (const char*)buffer + line.value_offset;
+                        const bool key_ok = (line.key_offset < size) && (line.key_offset + strlen(key) < line.value_offset);
+                        const bool value_ok = (line.value_offset < size) && (line.value_offset + strlen(value) <= size);
+                        const bool hash_ok = hash_fnv1a(key) == line.key_hash;
+                        if (!key_ok || !value_ok || !hash_ok) ++fuzz_errors;
+
+                        // the decoders must stay inside the value too
+                        char decoded[64];
+                        uint32_t length;
+                        ConfigReadEscapedString(value, decoded, sizeof(decoded), &length);
+                        ConfigReadData(value, decoded, 1 + random() % sizeof(decoded));
+                }
+                free(buffer);
+        }
+        DEBUG("Settings parser fuzz: 20000 files, %u errors", fuzz_errors);
+}
+#endif // MODMENU_DEBUG
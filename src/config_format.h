@@ -0,0 +1,99 @@
+#pragma once
+
+#include "main.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// the text format of the settings files: the line parser, the key lookup, and the
+// value writers and decoders used by settings.cpp. nothing here depends on windows,
+// imgui, or the settings tables, so it also builds in tools/harness.cpp
+
+
+// the type of the value held in Setting::cache
+enum SettingCacheType : uint32_t {
+        SCT_None = 0,
+        SCT_U32,
+        SCT_Float,
+        SCT_Bool,
+        SCT_String, // unescaped length of a string value with no escape sequences
+};
+
+struct Setting {
+        uint64_t key_hash;
+        uint32_t key_offset;
+        uint32_t value_offset;
+        // the parsed value is cached here on the first read so that repeated
+        // reads of the same key skip the parser, a reload starts the lines it
+        // reparsed with an empty cache
+        // upper 32 bits: SettingCacheType, lower 32 bits: the value
+        // atomic because readers on any thread fill it in, relaxed is enough
+        // since the type and value are always stored together
+        std::atomic<uint64_t> cache;
+
+        Setting() : key_hash(0), key_offset(0), value_offset(0), cache(0) {}
+        Setting(const Setting& other) { *this = other; }
+        Setting& operator=(const Setting& other) {
+                key_hash = other.key_hash;
+                key_offset = other.key_offset;
+                value_offset = other.value_offset;
+                cache.store(other.cache.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                return *this;
+        }
+};
+static_assert(sizeof(Setting) == 24, "update the memory estimate in ConfigParseLines()");
+constexpr static bool operator < (const Setting& A, const Setting& B) { return A.key_hash < B.key_hash; }
+constexpr static bool operator < (const Setting& A, const uint64_t B) { return A.key_hash < B; }
+constexpr static bool operator < (const uint64_t A, const Setting& B) { return A < B.key_hash; }
+
+
+static inline uint64_t hash_fnv1a(const char* str) {
+        uint64_t ret = 0xcbf29ce484222325;
+
+        unsigned char c;
+        while (c = *str++) {
+                ret ^= c;
+                ret *= 0x00000100000001B3;
+        }
+
+        return ret;
+}
+
+
+// parse the lines starting at `begin` into `lines` until the first null character
+// `begin` must be the start of a line inside `buffer` and the last line must end with a newline
+// returns the position of the null that stopped the parser
+extern unsigned char* ConfigParseLines(unsigned char* buffer, unsigned char* begin, std::vector<Setting>* lines);
+
+// find "mod_name:key_name" in `lines` sorted by hash, returns NULL if it is not there
+extern Setting* ConfigFindKey(std::vector<Setting>& lines, const unsigned char* buffer, const char* mod_name, const char* key_name);
+
+
+// the writer appends to a 4kb buffer, a full buffer is passed to `flush`
+// or appended to `memory` when that is not NULL
+typedef void (*CONFIG_FLUSH)(const char* data, uint32_t size);
+extern void BufferedOutputStart(CONFIG_FLUSH flush, std::string* memory);
+extern void BufferedOutputFlush();
+extern void BufferedOutputWriteBytes(const char* data, uint32_t size);
+extern void BufferedOutputWrite(const char* text);
+
+// one "mod_name:key_name!value" line, write the key and then one of the values
+extern void ConfigWriteKeyText(const char* mod_name, const char* key_name);
+extern void ConfigWriteU32Value(uint32_t value);
+extern void ConfigWriteFloatValue(float value);
+extern void ConfigWriteBoolValue(bool value);
+extern void ConfigWriteStringValue(const char* str);
+extern void ConfigWriteDataValue(const void* data, uint32_t data_size, bool as_base64);
+
+// returns true if the value had no escape sequences and was not truncated
+// in that case `out_length` receives the length of the string
+extern bool ConfigReadEscapedString(const char* in_value, char* out, uint32_t out_size, uint32_t* out_length);
+
+// returns false if the value is not exactly `buffer_size` bytes of hex or base64
+extern bool ConfigReadData(const char* in_data, char* out_buffer, uint32_t buffer_size);
+
+
+#ifdef MODMENU_DEBUG
+extern void ConfigFormatBenchmark();
+#endif
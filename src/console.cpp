@@ -33,6 +33,10 @@ static LogBufferHandle ConsoleOutput = 0;
 static char IOBuffer[256 * 1024];
 static std::vector<uint32_t> SearchOutputLines{};
 static std::vector<uint32_t> SearchHistoryLines{};
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+static uint64_t SearchOutputFirstLine = 0;
+static uint32_t ConsoleOutputMaxLines = 100000;
+#endif
 
 static uint32_t NumHotkeys = 0;
 static RegistrationHandle ModHandle = 0;
@@ -43,6 +47,17 @@ struct Command {
 } HotkeyCommands[NUM_HOTKEY_COMMANDS];
 
 
+// the number of lines ever printed to the output, the line count alone
+// stops changing once the output is full and old lines are dropped
+static uint64_t console_output_lines_printed() {
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+        return LogBuffer->GetFirstLineNumber(ConsoleOutput) + LogBuffer->GetLineCount(ConsoleOutput);
+#else
+        return LogBuffer->GetLineCount(ConsoleOutput);
+#endif
+}
+
+
 static void draw_console_window(void*) {
         if(!GameHook->IsConsoleReady()) {
                 SimpleDraw->Text("Waiting for console to become ready...");
@@ -57,8 +72,8 @@ static void draw_console_window(void*) {
         
         ImGui::SetNextItemWidth(-(ImGui::GetFontSize() * 12.0f));
 
-        static uint32_t line_count = 0;
-        const auto cur_lines = LogBuffer->GetLineCount(ConsoleOutput);
+        static uint64_t line_count = 0;
+        const auto cur_lines = console_output_lines_printed();
         if (line_count != cur_lines) {
                 line_count = cur_lines;
                 UpdateScroll = true;
@@ -86,6 +101,9 @@ static void draw_console_window(void*) {
         else if (CommandMode == InputMode::SearchOutput) {
                 if (ImGui::InputText("Search Output ", IOBuffer, sizeof(IOBuffer), ImGuiInputTextFlags_CallbackCompletion, CALLBACK_inputtext_switch_mode)) {
                         SearchOutputLines.clear();
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+                        SearchOutputFirstLine = LogBuffer->GetFirstLineNumber(ConsoleOutput);
+#endif
                         for (uint32_t i = 0; i < LogBuffer->GetLineCount(ConsoleOutput); ++i) {
                                 if (strcasestr(LogBuffer->GetLine(ConsoleOutput, i), IOBuffer)) {
                                         SearchOutputLines.push_back(i);
@@ -95,7 +113,24 @@ static void draw_console_window(void*) {
                 SimpleDraw->SameLine();
                 if (SimpleDraw->Button("Clear")) {
                         LogBuffer->Clear(ConsoleOutput);
+                        SearchOutputLines.clear();
                 }
+
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+                // old lines dropped from the output shift the line numbers of the search results
+                const auto first_line = LogBuffer->GetFirstLineNumber(ConsoleOutput);
+                if (first_line != SearchOutputFirstLine) {
+                        const auto dropped = first_line - SearchOutputFirstLine;
+                        uint32_t kept = 0;
+                        for (const auto line : SearchOutputLines) {
+                                if (line >= dropped) {
+                                        SearchOutputLines[kept++] = (uint32_t)(line - dropped);
+                                }
+                        }
+                        SearchOutputLines.resize(kept);
+                        SearchOutputFirstLine = first_line;
+                }
+#endif
                 SimpleDraw->ShowFilteredLogBuffer(ConsoleOutput, SearchOutputLines.data(), (uint32_t)SearchOutputLines.size(), UpdateScroll);
         }
         else if (CommandMode == InputMode::SearchHistory) {
@@ -110,6 +145,7 @@ static void draw_console_window(void*) {
                 SimpleDraw->SameLine();
                 if (SimpleDraw->Button("Clear")) {
                         LogBuffer->Clear(ConsoleInput);
+                        SearchHistoryLines.clear();
                 }
                 SimpleDraw->ShowFilteredLogBuffer(ConsoleInput, SearchHistoryLines.data(), (uint32_t)SearchHistoryLines.size(), UpdateScroll);
         }
@@ -206,6 +242,17 @@ static void CALLBACK_console_settings(enum ConfigAction action) {
                 snprintf(keyname, sizeof(keyname), "Hotkey Command%u", i);
                 Config->ConfigString(action, keyname, hc.data, sizeof(hc.data));
         }
+
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+        // the full output is still appended to BetterConsoleOutput.txt
+        // the editor only applies the limit once the value is committed, every value
+        // passed while dragging or typing would otherwise drop part of the output
+        Config->ConfigU32(action, "Console Output Max Lines (0 = unlimited)", &ConsoleOutputMaxLines);
+        const bool committed = (action == ConfigAction_Read) || ((action == ConfigAction_Edit) && ImGui::IsItemDeactivatedAfterEdit());
+        if (ConsoleOutput && committed) {
+                LogBuffer->SetLimits(ConsoleOutput, 0, ConsoleOutputMaxLines);
+        }
+#endif
 }
 
 static void CALLBACK_console_hotkey(uintptr_t userdata) {
@@ -241,6 +288,9 @@ extern void setup_console(const BetterAPI* api) {
 
         ConsoleInput = GameHook_GetConsoleInputHandle();
         ConsoleOutput = GameHook->GetConsoleOutputHandle();
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+        LogBuffer->SetLimits(ConsoleOutput, 0, ConsoleOutputMaxLines);
+#endif
         
         IOBuffer[0] = 0;
 }
\ No newline at end of file
@@ -1,10 +1,26 @@
 #include "main.h"
 #include "csv_parser.h"
+#include "parser.h"
 
 #include <Windows.h>
+#include <intrin.h>
+#include <emmintrin.h>
+#include <wmmintrin.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#ifdef MODMENU_DEBUG
+#include <chrono>
+#endif
+
+
+static const auto Parser = GetParserAPI();
+
 
 static bool FileReadAll(const char* filename, char** out_buffer, uint32_t* out_size) {
         char path[MAX_PATH];
@@ -42,6 +58,46 @@ static bool FileReadAll(const char* filename, char** out_buffer, uint32_t* out_s
 }
 
 
+// map a file copy-on-write so the csv parser can use it in place
+// returns false if the file cannot be mapped, the caller should fall back to FileReadAll()
+// the tokenizer relies on a null character after the end of the file, the unused part of
+// the last page of a mapping is zero filled, but a file that is an exact multiple of the
+// page size has no room for it and is not mapped
+static bool FileMapAll(const char* filename, char** out_buffer, uint32_t* out_size) {
+        char path[MAX_PATH];
+        GetPathInDllDir(path, filename);
+
+        const auto hfile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hfile == INVALID_HANDLE_VALUE) {
+                return false;
+        }
+
+        const auto file_size = GetFileSize(hfile, NULL);
+        if ((file_size == INVALID_FILE_SIZE) || (file_size == 0) || !(file_size & 4095)) {
+                CloseHandle(hfile);
+                return false;
+        }
+
+        // the view keeps the mapping and the file open after the handles are closed
+        const auto mapping = CreateFileMappingA(hfile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        CloseHandle(hfile);
+        if (mapping == NULL) {
+                return false;
+        }
+
+        const auto view = (char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        CloseHandle(mapping);
+        if (view == NULL) {
+                return false;
+        }
+
+        *out_buffer = view;
+        *out_size = file_size;
+
+        return true;
+}
+
+
 struct CSVFile {
         char* file_buffer;
         uint32_t* cells;
@@ -50,112 +106,533 @@ struct CSVFile {
         uint32_t line_count;
         uint32_t column_count;
         uint32_t cell_count;
+
+        // file_buffer is a copy-on-write view of the file instead of a heap copy
+        bool mapped;
+
+        // the length of each cell if known (from the index, or the cells were unescaped)
+        uint32_t* cell_lengths;
+
+        // cells and cell_lengths point into a mapped index file instead of the heap
+        void* index_view;
 };
 
 
-static CSVFile* CSV_Load(const char* filename) {
-        CSVFile *ret = (CSVFile*) malloc(sizeof(*ret));
-        ASSERT(ret != NULL);
-        memset(ret, 0, sizeof(*ret));
+// bitmasks of the characters the tokenizer cares about in a 64 byte block, bit N is byte N
+struct CSVBlockMasks {
+        uint64_t quote;
+        uint64_t comma;
+        uint64_t newline;
+        uint64_t carriage_return;
+};
 
-        if (!FileReadAll(filename, &ret->file_buffer, &ret->buffer_size)) {
-                free(ret);
-                return NULL;
+
+static inline uint64_t CSVMatchBlock(const __m128i block[4], char c) {
+        const __m128i needle = _mm_set1_epi8(c);
+        const uint64_t m0 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block[0], needle));
+        const uint64_t m1 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block[1], needle));
+        const uint64_t m2 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block[2], needle));
+        const uint64_t m3 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block[3], needle));
+        return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+
+
+static inline void CSVReadBlockMasks(const char* in, CSVBlockMasks* out) {
+        __m128i block[4];
+        block[0] = _mm_loadu_si128((const __m128i*)(in + 0));
+        block[1] = _mm_loadu_si128((const __m128i*)(in + 16));
+        block[2] = _mm_loadu_si128((const __m128i*)(in + 32));
+        block[3] = _mm_loadu_si128((const __m128i*)(in + 48));
+        out->quote = CSVMatchBlock(block, '"');
+        out->comma = CSVMatchBlock(block, ',');
+        out->newline = CSVMatchBlock(block, '\n');
+        out->carriage_return = CSVMatchBlock(block, '\r');
+}
+
+
+static bool CSVHasCarrylessMultiply() {
+        static const bool has_pclmulqdq = []() noexcept -> bool {
+                int info[4];
+                __cpuid(info, 1);
+                return (info[2] & (1 << 1)) != 0;
+        }();
+        return has_pclmulqdq;
+}
+
+
+// bit N of the result is the xor of bits 0 to N of `quotes`
+// for any byte that is not a quote, that is 1 when the byte is inside quotes
+// a carry-less multiply by all ones does the whole prefix xor in one instruction
+static inline uint64_t CSVPrefixXor(uint64_t quotes, bool clmul) {
+        if (clmul) {
+                const __m128i product = _mm_clmulepi64_si128(_mm_set_epi64x(0, (int64_t)quotes), _mm_set1_epi8((char)0xFF), 0);
+                return (uint64_t)_mm_cvtsi128_si64(product);
         }
+        quotes ^= quotes << 1;
+        quotes ^= quotes << 2;
+        quotes ^= quotes << 4;
+        quotes ^= quotes << 8;
+        quotes ^= quotes << 16;
+        quotes ^= quotes << 32;
+        return quotes;
+}
+
+
+// find where the cell after the separator at `pos - 1` starts (or the start of the file when pos is 0)
+// returns false if there is no cell because the file ends first
+// the old byte at a time parser skipped any quotes at the start of a cell
+// and an unquoted carriage return followed by a newline
+static inline bool CSVCellStart(const char* buffer, uint32_t size, uint32_t pos, uint32_t* out_cell) {
+        uint32_t p = pos;
+        while ((p < size) && (buffer[p] == '"')) ++p;
+        if (p >= size) return false;
+
+        // only quotes were skipped, so their count tells if p is inside quotes
+        if ((buffer[p] == '\r') && !((p - pos) & 1) && (buffer[p + 1] == '\n')) ++p;
+
+        *out_cell = p;
+        return true;
+}
+
+
+// the tokenizer works on 64 byte blocks:
+// 1) find the quotes, commas, newlines and carriage returns with simd compares
+// 2) the prefix xor of the quotes gives the bytes that are inside quotes, a pair
+//    of escaped quotes toggles twice so they need no special handling
+// 3) walk only the commas and newlines outside of quotes to count columns and
+//    lines, null terminate the cells, and emit the cell offsets
+// the result is identical to the previous byte at a time parser, which had a few quirks:
+// a cell starts at the first character after a separator that is not a quote,
+// a newline on a line without any commas does not end the line,
+// and a carriage return outside of quotes followed by a newline is nulled and skipped
+static bool CSVTokenize(CSVFile* ret) {
+        char* const buffer = ret->file_buffer;
+        const uint32_t size = ret->buffer_size;
+        const bool clmul = CSVHasCarrylessMultiply();
 
         uint32_t lines = 0;
         uint32_t columns = 0;
-        bool in_quotes = false;
-        bool cell_start = true;
-        const auto start = ret->file_buffer;
-        const auto end = ret->file_buffer + ret->buffer_size;
-        char* csv = ret->file_buffer;
-        std::vector<uint32_t> cells;
-        while (csv < end) {
-                if (*csv == '\r' && !in_quotes) {
-                        if (*(csv + 1) == '\n') {
-                                //DEBUG("unquoted CRLF");
-                                *csv = '\0';
-                                ++csv;
-                        }
-                        else {
-                                //DEBUG("unquoted CR");
-                        }
+        uint64_t inside_carry = 0; // all ones if the previous block ended inside quotes
+
+        uint32_t cell_capacity = 1024;
+        uint32_t cell_count = 0;
+        uint32_t* cells = (uint32_t*)malloc(cell_capacity * sizeof(uint32_t));
+        ASSERT(cells != NULL);
+
+        const auto push_cell = [&](uint32_t pos) {
+                uint32_t cell;
+                if (!CSVCellStart(buffer, size, pos, &cell)) return;
+
+                if (cell_count == cell_capacity) {
+                        cell_capacity *= 2;
+                        cells = (uint32_t*)realloc(cells, cell_capacity * sizeof(uint32_t));
+                        ASSERT(cells != NULL);
                 }
+                cells[cell_count++] = cell;
+        };
 
-                
-                if (*csv == '"') {
-                        if (in_quotes) {
-                                if (*(csv + 1) == '"') {
-                                        //DEBUG("Escaped quote");
-                                        ++csv;
-                                }
-                                else {
-                                        //DEBUG("Closing quote");
-                                        in_quotes = false;
-                                }
+        push_cell(0);
+
+        for (uint32_t base = 0; base < size; base += 64) {
+                const uint32_t remain = size - base;
+                CSVBlockMasks masks;
+                if (remain >= 64) {
+                        CSVReadBlockMasks(buffer + base, &masks);
+                }
+                else {
+                        // the zero padding does not match anything
+                        alignas(16) char tail[64] = {};
+                        memcpy(tail, buffer + base, remain);
+                        CSVReadBlockMasks(tail, &masks);
+                }
+
+                const uint64_t inside = CSVPrefixXor(masks.quote, clmul) ^ inside_carry;
+                inside_carry = (uint64_t)((int64_t)inside >> 63);
+
+                uint64_t separators = (masks.comma | masks.newline) & ~inside;
+                while (separators) {
+                        unsigned long bit;
+                        _BitScanForward64(&bit, separators);
+                        separators &= separators - 1;
+
+                        const uint32_t pos = base + bit;
+                        buffer[pos] = '\0';
+
+                        if ((masks.comma >> bit) & 1) {
+                                ++columns;
                         }
                         else {
-                                //DEBUG("Starting Quote");
-                                in_quotes = true;
-                        }
-                }
-                else if (cell_start) {
-                        const auto pos = (uint32_t)(csv - start);
-                        //DEBUG("Cell Start at %u (%c)", pos, *csv);
-                        cell_start = false;
-                        cells.push_back(pos);
-                }
-
-                if (*csv == '\n') {
-                        if (!in_quotes) {
-                                *csv = '\0';
-                                if (columns) {
-                                        ++lines;
-                                        ++columns;
-                                        if (!ret->column_count) {
-                                                ret->column_count = columns;
-                                        }
-                                        //DEBUG("unquoted newline with %u columns", columns);
-                                        if (columns != ret->column_count) {
-                                                DEBUG("Column count mismatch: %u != %u", columns, ret->column_count);
-                                                goto PARSE_ERROR;
-                                        }
-                                        columns = 0;
-                                        cell_start = true;
+                                if (!columns) continue; //a newline with no columns is ignored
+
+                                ++lines;
+                                ++columns;
+                                if (!ret->column_count) {
+                                        ret->column_count = columns;
                                 }
-                                else {
-                                        //DEBUG("Unquoted newline with no columns");
+                                if (columns != ret->column_count) {
+                                        DEBUG("Column count mismatch: %u != %u", columns, ret->column_count);
+                                        goto PARSE_ERROR;
                                 }
+                                columns = 0;
                         }
-                        else {
-                                //DEBUG("Quoted newline");
+
+                        push_cell(pos + 1);
+                }
+
+                // the carriage return of a CRLF outside of quotes, done after the separators
+                // because push_cell() needs to see the original character
+                const uint64_t next_is_newline = (remain > 64) && (buffer[base + 64] == '\n');
+                uint64_t crlf = masks.carriage_return & ~inside & ((masks.newline >> 1) | (next_is_newline << 63));
+                while (crlf) {
+                        unsigned long bit;
+                        _BitScanForward64(&bit, crlf);
+                        crlf &= crlf - 1;
+                        buffer[base + bit] = '\0';
+                }
+        }
+        if (inside_carry) {
+                DEBUG("Unterminated quote");
+                goto PARSE_ERROR;
+        }
+
+        // handle if the file did not end in a newline
+        if (columns) {
+                ++lines;
+        }
+
+        ret->line_count = lines;
+        ret->cell_count = lines * ret->column_count;
+        if (cell_count != ret->cell_count) {
+                DEBUG("Cell count mismatch: cell_size(%u) != cell_count(%u)", cell_count, ret->cell_count);
+                goto PARSE_ERROR;
+        }
+        ret->cells = cells;
+        return true;
+
+PARSE_ERROR:
+        free(cells);
+        return false;
+}
+
+
+// one slice of the file for the parallel tokenizer
+// the quote state at the start of a chunk is not known until every chunk before it
+// has been scanned, so the scan records the separators for both possible states
+struct CSVChunk {
+        uint32_t begin;
+        uint32_t end;
+
+        // from the scan, index 0 is the chunk starting outside quotes and 1 inside quotes
+        // positions of the commas, newlines and CRLF carriage returns outside quotes
+        std::vector<uint32_t> events[2];
+        uint32_t commas[2];
+        uint32_t commas_after_newline[2];
+        bool has_newline[2];
+        bool odd_quotes;
+
+        // from the prefix pass
+        uint32_t state;
+        uint32_t columns_in;
+
+        // from the stitch
+        std::vector<uint32_t> cells;
+        uint32_t lines;
+        uint32_t first_columns; // column count of the first line ending in this chunk
+        uint32_t bad_columns; // first column count in this chunk different from first_columns
+        uint32_t cell_offset;
+};
+
+
+// pass 1: classify every block in the chunk with the chunk starting outside quotes,
+// the bytes inside quotes for the other start state are just the complement
+// this pass must not write to the buffer, other chunks read past their end
+static void CSVChunkScan(const char* buffer, uint32_t size, CSVChunk* chunk, bool clmul) {
+        uint64_t inside_carry = 0;
+
+        for (uint32_t base = chunk->begin; base < chunk->end; base += 64) {
+                const uint32_t remain = size - base;
+                CSVBlockMasks masks;
+                if (remain >= 64) {
+                        CSVReadBlockMasks(buffer + base, &masks);
+                }
+                else {
+                        alignas(16) char tail[64] = {};
+                        memcpy(tail, buffer + base, remain);
+                        CSVReadBlockMasks(tail, &masks);
+                }
+
+                const uint64_t inside = CSVPrefixXor(masks.quote, clmul) ^ inside_carry;
+                inside_carry = (uint64_t)((int64_t)inside >> 63);
+
+                const uint64_t next_is_newline = (remain > 64) && (buffer[base + 64] == '\n');
+                const uint64_t crlf = masks.carriage_return & ((masks.newline >> 1) | (next_is_newline << 63));
+                const uint64_t candidates = masks.comma | masks.newline | crlf;
+
+                for (uint32_t state = 0; state < 2; ++state) {
+                        uint64_t events = candidates & (state ? inside : ~inside);
+                        while (events) {
+                                unsigned long bit;
+                                _BitScanForward64(&bit, events);
+                                events &= events - 1;
+                                chunk->events[state].push_back(base + bit);
                         }
-                } else if (*csv == ',') {
-                        if (!in_quotes) {
-                                //DEBUG("Unquoted comma");
-                                *csv = '\0';
-                                ++columns;
-                                cell_start = true;
+                }
+        }
+        chunk->odd_quotes = (inside_carry != 0);
+
+        // what the chunk does to the column counter, so the prefix pass can skip ahead
+        // every newline leaves the counter at 0 whether or not it ended a line
+        for (uint32_t state = 0; state < 2; ++state) {
+                uint32_t commas = 0;
+                uint32_t after_newline = 0;
+                bool has_newline = false;
+                for (const auto pos : chunk->events[state]) {
+                        if (buffer[pos] == ',') {
+                                ++commas;
+                                ++after_newline;
                         }
-                        else {
-                                //DEBUG("Quoted Comma");
+                        else if (buffer[pos] == '\n') {
+                                has_newline = true;
+                                after_newline = 0;
                         }
                 }
+                chunk->commas[state] = commas;
+                chunk->commas_after_newline[state] = after_newline;
+                chunk->has_newline[state] = has_newline;
+        }
+}
+
+
+// pass 3: with the real start state and column counter known, count the lines
+// and find the cells, this is the same logic as CSVTokenize() minus the writes
+static void CSVChunkStitch(const char* buffer, uint32_t size, CSVChunk* chunk) {
+        uint32_t columns = chunk->columns_in;
+        uint32_t cell;
+
+        chunk->lines = 0;
+        chunk->first_columns = 0;
+        chunk->bad_columns = 0;
+
+        if ((chunk->begin == 0) && CSVCellStart(buffer, size, 0, &cell)) {
+                chunk->cells.push_back(cell);
+        }
+
+        for (const auto pos : chunk->events[chunk->state]) {
+                const char c = buffer[pos];
+                if (c == '\r') continue;
+
+                if (c == ',') {
+                        ++columns;
+                }
                 else {
-                        if (in_quotes) {
-                                //DEBUG("in_quotes: (%c)", *csv);
+                        if (!columns) continue;
+
+                        ++chunk->lines;
+                        ++columns;
+                        if (!chunk->first_columns) {
+                                chunk->first_columns = columns;
                         }
-                        else {
-                                //DEBUG("Other Unquoted: (%c)", *csv);
+                        else if ((columns != chunk->first_columns) && !chunk->bad_columns) {
+                                chunk->bad_columns = columns;
                         }
+                        columns = 0;
+                }
+
+                if (CSVCellStart(buffer, size, pos + 1, &cell)) {
+                        chunk->cells.push_back(cell);
+                }
+        }
+}
+
+
+// pass 4: null terminate the cells and copy the cell offsets into place
+static void CSVChunkFinish(char* buffer, const CSVChunk* chunk, uint32_t* cells) {
+        for (const auto pos : chunk->events[chunk->state]) {
+                buffer[pos] = '\0';
+        }
+        if (!chunk->cells.empty()) {
+                memcpy(cells + chunk->cell_offset, chunk->cells.data(), chunk->cells.size() * sizeof(uint32_t));
+        }
+}
+
+
+// how many threads to split `work` across so each thread gets at least `min_work` of it
+static uint32_t CSVThreadCount(uint32_t work, uint32_t min_work) {
+        uint32_t count = work / min_work;
+        const uint32_t threads = std::thread::hardware_concurrency();
+        if (count > threads) count = threads;
+        if (count > 16) count = 16;
+        return count;
+}
+
+
+typedef void (*CSV_POOL_JOB)(const void* context, uint32_t i);
+
+// the worker threads of CSVParallelFor(), started the first time a csv is split across threads
+// and kept so a load or ReadColumn call does not pay for creating threads every time
+// the pool is never freed, the workers sleep on `job_ready` until the process exits
+struct CSVThreadPool {
+        std::mutex busy; // held by the thread running a job for the whole job
+
+        std::mutex lock; // protects the job and `running`
+        std::condition_variable job_ready;
+        std::condition_variable job_done;
+        uint64_t job_id;
+        CSV_POOL_JOB job;
+        const void* context;
+        uint32_t count; // 0 once the job has finished
+        uint32_t running; // workers that took the current job and have not finished it
+        std::atomic<uint32_t> next;
+};
+
+
+// run `job(context, i)` until every index of the job has been taken
+static void CSVPoolWork(CSVThreadPool* pool, CSV_POOL_JOB job, const void* context, uint32_t count) {
+        for (uint32_t i = pool->next.fetch_add(1, std::memory_order_relaxed); i < count; i = pool->next.fetch_add(1, std::memory_order_relaxed)) {
+                job(context, i);
+        }
+}
+
+
+static void CSVPoolWorker(CSVThreadPool* pool) {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> guard(pool->lock);
+        for (;;) {
+                pool->job_ready.wait(guard, [&]() { return pool->job_id != seen; });
+                seen = pool->job_id;
+
+                // a worker that wakes after the job finished must not touch `next` at all, the
+                // caller may already be starting the next job and the index it took would never run
+                // while `running` is not 0 the job cannot finish, so the indices a worker that
+                // joined in time takes from `next` always belong to its own job
+                if (pool->count == 0) continue;
+
+                const auto job = pool->job;
+                const auto context = pool->context;
+                const auto count = pool->count;
+                ++pool->running;
+                guard.unlock();
+
+                CSVPoolWork(pool, job, context, count);
+
+                guard.lock();
+                if (--pool->running == 0) {
+                        pool->job_done.notify_all();
+                }
+        }
+}
+
+
+static CSVThreadPool* CSVGetThreadPool() {
+        static CSVThreadPool* const pool = []() {
+                const auto ret = new CSVThreadPool{};
+                // the calling thread takes part in every job, same limit as CSVThreadCount()
+                uint32_t workers = std::thread::hardware_concurrency();
+                if (workers > 16) workers = 16;
+                for (uint32_t i = 1; i < workers; ++i) {
+                        std::thread(CSVPoolWorker, ret).detach();
+                }
+                return ret;
+        }();
+        return pool;
+}
+
+
+// run `func(i)` for i in [0, count) on the thread pool and the calling thread
+// if another thread is already using the pool everything runs on the calling thread instead of waiting
+template<typename FUNC>
+static void CSVParallelFor(uint32_t count, const FUNC& func) {
+        const CSV_POOL_JOB job = [](const void* context, uint32_t i) {
+                (*(const FUNC*)context)(i);
+        };
+
+        CSVThreadPool* const pool = CSVGetThreadPool();
+        std::unique_lock<std::mutex> busy(pool->busy, std::try_to_lock);
+        if (!busy.owns_lock()) {
+                for (uint32_t i = 0; i < count; ++i) {
+                        func(i);
                 }
+                return;
+        }
+
+        std::unique_lock<std::mutex> guard(pool->lock);
+        pool->job = job;
+        pool->context = &func;
+        pool->count = count;
+        pool->next.store(0, std::memory_order_relaxed);
+        ++pool->job_id;
+        guard.unlock();
+        pool->job_ready.notify_all();
+
+        CSVPoolWork(pool, job, &func, count);
+
+        // every index has been taken, wait for the workers still running theirs
+        guard.lock();
+        pool->job_done.wait(guard, [pool]() { return pool->running == 0; });
+        pool->count = 0;
+}
+
+
+// same result and same errors as CSVTokenize(), but the file is split into chunks that are
+// scanned in parallel for both quote states, a cheap serial prefix pass over the chunk
+// summaries picks the real quote state and column counter at the start of each chunk,
+// then the chunks are stitched and written in parallel
+static bool CSVTokenizeParallel(CSVFile* ret, uint32_t chunk_count) {
+        char* const buffer = ret->file_buffer;
+        const uint32_t size = ret->buffer_size;
+        const bool clmul = CSVHasCarrylessMultiply();
+
+        // chunks are whole blocks so every chunk sees the same 64 byte blocks as the serial tokenizer
+        const uint32_t chunk_size = ((size / chunk_count) + 63) & ~63u;
+        std::vector<CSVChunk> chunks(chunk_count);
+        uint32_t begin = 0;
+        for (auto& chunk : chunks) {
+                chunk.begin = begin;
+                chunk.end = (size - begin > chunk_size) ? begin + chunk_size : size;
+                begin = chunk.end;
+        }
+        chunks.back().end = size;
+
+        CSVParallelFor(chunk_count, [&](uint32_t i) {
+                CSVChunkScan(buffer, size, &chunks[i], clmul);
+        });
+
+        uint32_t state = 0;
+        uint32_t columns = 0;
+        for (auto& chunk : chunks) {
+                chunk.state = state;
+                chunk.columns_in = columns;
+                columns = (chunk.has_newline[state]) ? chunk.commas_after_newline[state] : columns + chunk.commas[state];
+                state ^= chunk.odd_quotes;
+        }
+
+        CSVParallelFor(chunk_count, [&](uint32_t i) {
+                CSVChunkStitch(buffer, size, &chunks[i]);
+        });
 
-                ++csv;
+        uint32_t lines = 0;
+        uint32_t cell_count = 0;
+        for (auto& chunk : chunks) {
+                if (chunk.lines) {
+                        if (!ret->column_count) {
+                                ret->column_count = chunk.first_columns;
+                        }
+                        if (chunk.first_columns != ret->column_count) {
+                                DEBUG("Column count mismatch: %u != %u", chunk.first_columns, ret->column_count);
+                                return false;
+                        }
+                        if (chunk.bad_columns) {
+                                DEBUG("Column count mismatch: %u != %u", chunk.bad_columns, ret->column_count);
+                                return false;
+                        }
+                }
+                lines += chunk.lines;
+                chunk.cell_offset = cell_count;
+                cell_count += (uint32_t)chunk.cells.size();
         }
-        if (in_quotes) {
+        if (state) {
                 DEBUG("Unterminated quote");
-                goto PARSE_ERROR;
+                return false;
         }
 
         // handle if the file did not end in a newline
@@ -165,47 +642,1799 @@ static CSVFile* CSV_Load(const char* filename) {
 
         ret->line_count = lines;
         ret->cell_count = lines * ret->column_count;
-        if (cells.size() != ret->cell_count) {
-                DEBUG("Cell count mismatch: cell_size(%u) != cell_count(%u)", cells.size(), ret->cell_count);
-                goto PARSE_ERROR;
+        if (cell_count != ret->cell_count) {
+                DEBUG("Cell count mismatch: cell_size(%u) != cell_count(%u)", cell_count, ret->cell_count);
+                return false;
         }
-        ret->cells = (uint32_t*)malloc(ret->cell_count * sizeof(uint32_t));
-        ASSERT(ret->cells != NULL);
-        memcpy(ret->cells, &cells[0], ret->cell_count * sizeof(uint32_t));
 
-        return ret;
+        uint32_t* cells = (uint32_t*)malloc((cell_count + 1) * sizeof(uint32_t));
+        ASSERT(cells != NULL);
 
-PARSE_ERROR:
-        free(ret->file_buffer);
-        memset(csv, 0, sizeof(*csv));
-        free(csv);
-        return NULL;
+        CSVParallelFor(chunk_count, [&](uint32_t i) {
+                CSVChunkFinish(buffer, &chunks[i], cells);
+        });
+
+        ret->cells = cells;
+        return true;
 }
 
 
-static void CSV_Close(CSVFile* csv) {
-        free(csv->file_buffer);
-        free(csv->cells);
-        memset(csv, 0, sizeof(*csv));
-        free(csv);
+static void CSVFreeBuffer(CSVFile* csv) {
+        if (csv->mapped) {
+                UnmapViewOfFile(csv->file_buffer);
+        }
+        else {
+                free(csv->file_buffer);
+        }
 }
 
 
-static void CSV_Info(const CSVFile* csv, uint32_t* out_line_count, uint32_t* out_column_count) {
-        if (out_line_count) {
-                *out_line_count = csv->line_count;
+// a fast non-cryptographic hash (the xxhash64 round function) of the file contents,
+// four independent lanes keep the multipliers busy
+static uint64_t CSVHashBytes(const char* data, uint32_t size) {
+        constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+        constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+
+        const auto round = [](uint64_t lane, uint64_t word) noexcept -> uint64_t {
+                return _rotl64(lane + word * prime2, 31) * prime1;
+        };
+
+        uint64_t lanes[4] = { prime1 + prime2, prime2, 0, 0 - prime1 };
+        uint32_t pos = 0;
+        for (; pos + 32 <= size; pos += 32) {
+                uint64_t words[4];
+                memcpy(words, data + pos, sizeof(words));
+                lanes[0] = round(lanes[0], words[0]);
+                lanes[1] = round(lanes[1], words[1]);
+                lanes[2] = round(lanes[2], words[2]);
+                lanes[3] = round(lanes[3], words[3]);
         }
-        if (out_column_count) {
-                *out_column_count = csv->column_count;
+
+        uint64_t hash = _rotl64(lanes[0], 1) + _rotl64(lanes[1], 7) + _rotl64(lanes[2], 12) + _rotl64(lanes[3], 18);
+        hash += size;
+        for (; pos < size; pos += 8) {
+                uint64_t word = 0;
+                memcpy(&word, data + pos, (size - pos < 8) ? size - pos : 8);
+                hash = _rotl64(hash ^ round(0, word), 27) * prime1 + prime3;
         }
+
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        hash *= prime3;
+        hash ^= hash >> 32;
+        return hash;
 }
 
 
-static const char* CSV_ReadCell(const CSVFile* csv, uint32_t row, uint32_t column) {
-        ASSERT(row < csv->line_count);
-        ASSERT(column < csv->column_count);
-        return &csv->file_buffer[csv->cells[row * csv->column_count + column]];
+// the sidecar index is written next to the csv file as "<filename>.index"
+// the header is followed by the cells array and then the length of each cell
+// an index written by a CSVLoad_Unescape load has the unescaped cells instead, followed by
+// the numbers of the cells that unescaping changed and then their unescaped text, so
+// loading it only copies that text over the quoted cells instead of unescaping again
+struct CSVIndexHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t file_size;
+        uint64_t file_time;
+        uint64_t file_hash;
+        uint32_t line_count;
+        uint32_t column_count;
+        uint32_t cell_count;
+        uint32_t flags;
+        uint32_t patch_count; // cells changed by unescaping
+        uint32_t patch_size; // bytes of unescaped text of those cells
+};
+
+static constexpr uint32_t CSVIndexMagic = 0x58444943; // "CIDX"
+static constexpr uint32_t CSVIndexVersion = 2;
+static constexpr uint32_t CSVIndexUnescaped = 1 << 0;
+
+
+static bool CSVIndexPath(const char* filename, char* out_path, uint64_t* out_file_time) {
+        char path[MAX_PATH];
+        GetPathInDllDir(path, filename);
+
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data)) return false;
+        *out_file_time = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+
+        const auto written = snprintf(out_path, MAX_PATH, "%s.index", path);
+        return (written > 0) && (written < MAX_PATH);
+}
+
+
+// use the index if it matches the file and was written with the same `unescape` setting,
+// the cells are used straight from the mapped index
+static bool CSVIndexOpen(CSVFile* csv, const char* index_path, uint64_t file_time, uint64_t file_hash, bool unescape) {
+        const auto hfile = CreateFileA(index_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hfile == INVALID_HANDLE_VALUE) {
+                return false;
+        }
+
+        const auto index_size = GetFileSize(hfile, NULL);
+        if ((index_size == INVALID_FILE_SIZE) || (index_size < sizeof(CSVIndexHeader))) {
+                CloseHandle(hfile);
+                return false;
+        }
+
+        const auto mapping = CreateFileMappingA(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(hfile);
+        if (mapping == NULL) {
+                return false;
+        }
+
+        const auto view = (char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (view == NULL) {
+                return false;
+        }
+
+        const auto header = (const CSVIndexHeader*)view;
+        const auto cells = (uint32_t*)(view + sizeof(*header));
+        const auto lengths = cells + header->cell_count;
+        const auto patched = lengths + header->cell_count;
+
+        bool valid = (header->magic == CSVIndexMagic) &&
+                (header->version == CSVIndexVersion) &&
+                (header->file_size == csv->buffer_size) &&
+                (header->file_time == file_time) &&
+                (header->file_hash == file_hash) &&
+                (((header->flags & CSVIndexUnescaped) != 0) == unescape) &&
+                ((uint64_t)header->line_count * header->column_count == header->cell_count) &&
+                (index_size == sizeof(*header) + ((uint64_t)header->cell_count * 2 + header->patch_count) * sizeof(uint32_t) + header->patch_size);
+
+        // a damaged index must not make us write outside the buffer
+        for (uint32_t i = 0; valid && (i < header->cell_count); ++i) {
+                valid = ((uint64_t)cells[i] + lengths[i] <= csv->buffer_size);
+        }
+        uint64_t patch_size = 0;
+        for (uint32_t i = 0; valid && (i < header->patch_count); ++i) {
+                valid = (patched[i] < header->cell_count);
+                if (valid) patch_size += lengths[patched[i]];
+        }
+        valid = valid && (patch_size == header->patch_size);
+
+        if (!valid) {
+                DEBUG("Index out of date: %s", index_path);
+                UnmapViewOfFile(view);
+                return false;
+        }
+
+        csv->index_view = view;
+        csv->cells = cells;
+        csv->cell_lengths = lengths;
+        csv->line_count = header->line_count;
+        csv->column_count = header->column_count;
+        csv->cell_count = header->cell_count;
+
+        // the unescaped text of the quoted cells goes over their raw text
+        const char* text = (const char*)(patched + header->patch_count);
+        for (uint32_t i = 0; i < header->patch_count; ++i) {
+                const uint32_t cell = patched[i];
+                memcpy(&csv->file_buffer[cells[cell]], text, lengths[cell]);
+                text += lengths[cell];
+        }
+
+        for (uint32_t i = 0; i < csv->cell_count; ++i) {
+                csv->file_buffer[cells[i] + lengths[i]] = '\0';
+        }
+
+        return true;
+}
+
+
+static bool CSVWriteAll(HANDLE hfile, const void* data, uint32_t size) {
+        DWORD written = 0;
+        return WriteFile(hfile, data, size, &written, NULL) && (written == size);
+}
+
+
+// `unescaped` is NULL for raw cells, or the cells CSVUnescapeCells() changed
+static void CSVIndexWrite(const CSVFile* csv, const char* index_path, uint64_t file_time, uint64_t file_hash, const std::vector<uint32_t>* unescaped) {
+        CSVIndexHeader header{};
+        header.magic = CSVIndexMagic;
+        header.version = CSVIndexVersion;
+        header.file_size = csv->buffer_size;
+        header.file_time = file_time;
+        header.file_hash = file_hash;
+        header.line_count = csv->line_count;
+        header.column_count = csv->column_count;
+        header.cell_count = csv->cell_count;
+
+        // unescaping recorded the lengths, raw cells are only null terminated
+        uint32_t* lengths = csv->cell_lengths;
+        if (!lengths) {
+                lengths = (uint32_t*)malloc((csv->cell_count + 1) * sizeof(uint32_t));
+                ASSERT(lengths != NULL);
+                for (uint32_t i = 0; i < csv->cell_count; ++i) {
+                        lengths[i] = (uint32_t)strlen(&csv->file_buffer[csv->cells[i]]);
+                }
+        }
+
+        // the unescaped text of the changed cells, in the order of `unescaped`
+        std::vector<char> patch_text;
+        if (unescaped) {
+                header.flags |= CSVIndexUnescaped;
+                header.patch_count = (uint32_t)unescaped->size();
+                for (const uint32_t cell : *unescaped) {
+                        const char* const text = &csv->file_buffer[csv->cells[cell]];
+                        patch_text.insert(patch_text.end(), text, text + lengths[cell]);
+                }
+                header.patch_size = (uint32_t)patch_text.size();
+        }
+
+        const auto free_lengths = [&]() {
+                if (lengths != csv->cell_lengths) free(lengths);
+        };
+
+        const auto hfile = CreateFileA(index_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hfile == INVALID_HANDLE_VALUE) {
+                DEBUG("Could not write index: %s", index_path);
+                free_lengths();
+                return;
+        }
+
+        const DWORD array_size = csv->cell_count * sizeof(uint32_t);
+        bool ok = CSVWriteAll(hfile, &header, sizeof(header));
+        ok = ok && CSVWriteAll(hfile, csv->cells, array_size);
+        ok = ok && CSVWriteAll(hfile, lengths, array_size);
+        if (unescaped) {
+                ok = ok && CSVWriteAll(hfile, unescaped->data(), header.patch_count * sizeof(uint32_t));
+                ok = ok && CSVWriteAll(hfile, patch_text.data(), header.patch_size);
+        }
+        CloseHandle(hfile);
+        free_lengths();
+
+        if (!ok) {
+                DEBUG("Could not write index: %s", index_path);
+                DeleteFileA(index_path);
+        }
+}
+
+
+// strip the quotes from quoted cells and turn "" into " in place, then record the length of every cell
+// the tokenizer skipped the opening quotes of a cell, so the quotes right before a cell start
+// tell if it was quoted, the unescaped text moves back to start at the first quote and
+// is never longer than the raw text
+// the numbers of the cells that were quoted are added to `out_changed` if it is not NULL
+static void CSVUnescapeCells(CSVFile* csv, std::vector<uint32_t>* out_changed) {
+        char* const buffer = csv->file_buffer;
+        const uint32_t count = csv->cell_count;
+
+        // a load from the index never unescapes, its cells are already final
+        ASSERT(csv->index_view == NULL);
+        ASSERT(csv->cell_lengths == NULL);
+        csv->cell_lengths = (uint32_t*)malloc((count + 1) * sizeof(uint32_t));
+        ASSERT(csv->cell_lengths != NULL);
+
+        for (uint32_t i = 0; i < count; ++i) {
+                const uint32_t cell = csv->cells[i];
+                const uint32_t end = cell + (uint32_t)strlen(&buffer[cell]);
+
+                uint32_t raw = cell;
+                while ((raw > 0) && (buffer[raw - 1] == '"')) --raw;
+                if (raw == cell) {
+                        // not quoted, already null terminated
+                        csv->cell_lengths[i] = end - cell;
+                        continue;
+                }
+
+                // copy the runs between quotes, a quote inside quotes followed by another
+                // quote is an escaped quote, any other quote opens or closes the quoted part
+                uint32_t in = raw;
+                uint32_t out = raw;
+                bool in_quotes = false;
+                while (in < end) {
+                        const auto quote = (const char*)memchr(&buffer[in], '"', end - in);
+                        const uint32_t run_end = (quote) ? (uint32_t)(quote - buffer) : end;
+                        if (out != in) {
+                                memmove(&buffer[out], &buffer[in], run_end - in);
+                        }
+                        out += run_end - in;
+                        in = run_end;
+                        if (in == end) break;
+
+                        if (in_quotes && (in + 1 < end) && (buffer[in + 1] == '"')) {
+                                buffer[out++] = '"';
+                                in += 2;
+                        }
+                        else {
+                                in_quotes = !in_quotes;
+                                ++in;
+                        }
+                }
+                buffer[out] = '\0';
+
+                csv->cells[i] = raw;
+                csv->cell_lengths[i] = out - raw;
+                if (out_changed) out_changed->push_back(i);
+        }
+}
+
+
+static CSVFile* CSV_LoadEx(const char* filename, uint32_t flags) {
+        CSVFile *ret = (CSVFile*) malloc(sizeof(*ret));
+        ASSERT(ret != NULL);
+        memset(ret, 0, sizeof(*ret));
+
+        if (flags & CSVLoad_MemoryMapped) {
+                ret->mapped = FileMapAll(filename, &ret->file_buffer, &ret->buffer_size);
+        }
+        if (!ret->mapped && !FileReadAll(filename, &ret->file_buffer, &ret->buffer_size)) {
+                free(ret);
+                return NULL;
+        }
+
+        // the hash has to be taken before the tokenizer writes into the buffer
+        char index_path[MAX_PATH];
+        uint64_t file_time = 0;
+        uint64_t file_hash = 0;
+        bool use_index = false;
+        bool from_index = false;
+        const bool unescape = (flags & CSVLoad_Unescape) != 0;
+        if (flags & CSVLoad_UseIndex) {
+                use_index = CSVIndexPath(filename, index_path, &file_time);
+                file_hash = CSVHashBytes(ret->file_buffer, ret->buffer_size);
+                from_index = use_index && CSVIndexOpen(ret, index_path, file_time, file_hash, unescape);
+        }
+
+        if (!from_index) {
+                // each thread should get at least a few megabytes to be worth starting
+                constexpr uint32_t min_chunk_size = 4 * 1024 * 1024;
+                uint32_t chunk_count = 1;
+                if (flags & CSVLoad_Parallel) {
+                        chunk_count = CSVThreadCount(ret->buffer_size, min_chunk_size);
+                }
+
+                const bool ok = (chunk_count > 1) ? CSVTokenizeParallel(ret, chunk_count) : CSVTokenize(ret);
+                if (!ok) {
+                        CSVFreeBuffer(ret);
+                        free(ret);
+                        return NULL;
+                }
+
+                // an index written after unescaping already has the unescaped cells
+                std::vector<uint32_t> unescaped;
+                if (unescape) {
+                        CSVUnescapeCells(ret, (use_index) ? &unescaped : NULL);
+                }
+                if (use_index) {
+                        CSVIndexWrite(ret, index_path, file_time, file_hash, (unescape) ? &unescaped : NULL);
+                }
+        }
+
+        return ret;
+}
+
+
+static CSVFile* CSV_Load(const char* filename) {
+        return CSV_LoadEx(filename, CSVLoad_Default);
+}
+
+
+static void CSV_Close(CSVFile* csv) {
+        CSVFreeBuffer(csv);
+        if (csv->index_view) {
+                UnmapViewOfFile(csv->index_view);
+        }
+        else {
+                free(csv->cells);
+                free(csv->cell_lengths);
+        }
+        memset(csv, 0, sizeof(*csv));
+        free(csv);
+}
+
+
+static void CSV_Info(const CSVFile* csv, uint32_t* out_line_count, uint32_t* out_column_count) {
+        if (out_line_count) {
+                *out_line_count = csv->line_count;
+        }
+        if (out_column_count) {
+                *out_column_count = csv->column_count;
+        }
+}
+
+
+// the text of a cell by its index in the cells array
+static inline const char* CSVCellText(const CSVFile* csv, uint32_t index) {
+        return &csv->file_buffer[csv->cells[index]];
+}
+
+
+static const char* CSV_ReadCell(const CSVFile* csv, uint32_t row, uint32_t column) {
+        ASSERT(row < csv->line_count);
+        ASSERT(column < csv->column_count);
+        return CSVCellText(csv, row * csv->column_count + column);
+}
+
+
+static CSVStringView CSV_ReadCellView(const CSVFile* csv, uint32_t row, uint32_t column) {
+        ASSERT(row < csv->line_count);
+        ASSERT(column < csv->column_count);
+        const uint32_t index = row * csv->column_count + column;
+
+        CSVStringView ret;
+        ret.text = CSVCellText(csv, index);
+        ret.length = (csv->cell_lengths) ? csv->cell_lengths[index] : (uint32_t)strlen(ret.text);
+        return ret;
+}
+
+
+// convert the rows [begin, end) of a column with `parse(csv, cell_index, &value)`, failed rows are zeroed
+// if `row_list` is not NULL the rows converted are row_list[begin] to row_list[end - 1] instead
+// either way the value for element i goes to out_values[i], so a row list gives packed values
+// returns the number of rows that failed
+template<typename T, typename PARSE>
+static uint32_t CSVConvertRows(const CSVFile* csv, uint32_t column, const uint32_t* row_list, uint32_t begin, uint32_t end, T* out_values, bool* out_row_errors, const PARSE& parse) {
+        uint32_t errors = 0;
+        for (uint32_t i = begin; i < end; ++i) {
+                const uint32_t row = (row_list) ? row_list[i] : i;
+                T value;
+                const uint32_t index = row * csv->column_count + column;
+                const bool ok = parse(csv, index, &value);
+                if (!ok) {
+                        value = T{};
+                        ++errors;
+                }
+                out_values[i] = value;
+                if (out_row_errors) {
+                        out_row_errors[i] = !ok;
+                }
+        }
+        return errors;
+}
+
+
+static uint32_t CSVConvertColumn(const CSVFile* csv, uint32_t column, CSVColumnType type, void* out_values, bool* out_row_errors, const uint32_t* row_list, uint32_t begin, uint32_t end) {
+        switch (type) {
+        case CSVColumn_U32:
+                return CSVConvertRows(csv, column, row_list, begin, end, (uint32_t*)out_values, out_row_errors, [](const CSVFile* file, uint32_t index, uint32_t* value) {
+                        return Parser->ParseU32(CSVCellText(file, index), value, false);
+                });
+        case CSVColumn_S64:
+                return CSVConvertRows(csv, column, row_list, begin, end, (int64_t*)out_values, out_row_errors, [](const CSVFile* file, uint32_t index, int64_t* value) {
+                        return Parser->ParseS64(CSVCellText(file, index), value, false);
+                });
+        case CSVColumn_Float:
+                return CSVConvertRows(csv, column, row_list, begin, end, (float*)out_values, out_row_errors, [](const CSVFile* file, uint32_t index, float* value) {
+                        return Parser->ParseFloat(CSVCellText(file, index), value);
+                });
+        case CSVColumn_Double:
+                return CSVConvertRows(csv, column, row_list, begin, end, (double*)out_values, out_row_errors, [](const CSVFile* file, uint32_t index, double* value) {
+                        return Parser->ParseDouble(CSVCellText(file, index), value);
+                });
+        case CSVColumn_Bool:
+                return CSVConvertRows(csv, column, row_list, begin, end, (bool*)out_values, out_row_errors, [](const CSVFile* file, uint32_t index, bool* value) {
+                        return Parser->ParseBool(CSVCellText(file, index), value);
+                });
+        case CSVColumn_String:
+                return CSVConvertRows(csv, column, row_list, begin, end, (CSVStringView*)out_values, out_row_errors, [](const CSVFile* file, uint32_t index, CSVStringView* value) {
+                        value->text = CSVCellText(file, index);
+                        value->length = (file->cell_lengths) ? file->cell_lengths[index] : (uint32_t)strlen(value->text);
+                        return true;
+                });
+        }
+        ASSERT(false && "Invalid CSVColumnType");
+        return 0;
+}
+
+
+// the parse api is the slow part, so columns are split by rows across threads
+// each row only touches its own cell and output element
+static uint32_t CSV_ReadColumn(const CSVFile* csv, uint32_t column, CSVColumnType type, void* out_values, bool* out_row_errors) {
+        ASSERT(column < csv->column_count);
+        ASSERT(out_values != NULL);
+
+        const uint32_t rows = csv->line_count;
+
+        constexpr uint32_t min_rows_per_thread = 16 * 1024;
+        const uint32_t chunk_count = CSVThreadCount(rows, min_rows_per_thread);
+
+        if (chunk_count < 2) {
+                return CSVConvertColumn(csv, column, type, out_values, out_row_errors, NULL, 0, rows);
+        }
+
+        const uint32_t chunk_rows = (rows + chunk_count - 1) / chunk_count;
+        uint32_t errors[16] = {};
+        CSVParallelFor(chunk_count, [&](uint32_t i) {
+                const uint32_t begin = i * chunk_rows;
+                const uint32_t end = (rows - begin > chunk_rows) ? begin + chunk_rows : rows;
+                errors[i] = CSVConvertColumn(csv, column, type, out_values, out_row_errors, NULL, begin, end);
+        });
+
+        uint32_t total = 0;
+        for (uint32_t i = 0; i < chunk_count; ++i) {
+                total += errors[i];
+        }
+        return total;
+}
+
+
+// open addressing hash table of rows keyed by the text of one column
+// each key is in the table once with its first row, the other rows with the same key
+// are chained through `next_row` in ascending order
+struct CSVRowIndex {
+        struct Slot {
+                uint32_t hash;
+                uint32_t row; // UINT32_MAX if the slot is empty
+        };
+
+        const CSVFile* csv;
+        uint32_t column;
+        uint32_t mask; // slot count - 1
+        Slot* slots;
+        uint32_t* next_row;
+
+        // the worker is joined exactly once by whichever thread waits first,
+        // any other thread waiting at the same time blocks in call_once until it is done
+        std::thread worker;
+        std::once_flag joined;
+        std::atomic<bool> ready;
+};
+
+
+// the key text of a row
+static inline CSVStringView CSVIndexKey(const CSVRowIndex* index, uint32_t row) {
+        return CSV_ReadCellView(index->csv, row, index->column);
+}
+
+
+static inline uint32_t CSVIndexHash(const char* text, uint32_t length) {
+        return (uint32_t)CSVHashBytes(text, length);
+}
+
+
+static void CSVIndexBuild(CSVRowIndex* index) {
+        const uint32_t rows = index->csv->line_count;
+
+        // inserting from the last row to the first puts each chain in ascending order
+        for (uint32_t row = rows; row-- > 0;) {
+                const CSVStringView key = CSVIndexKey(index, row);
+                const uint32_t hash = CSVIndexHash(key.text, key.length);
+
+                uint32_t i = hash & index->mask;
+                for (;;) {
+                        auto& slot = index->slots[i];
+                        if (slot.row == UINT32_MAX) {
+                                slot.hash = hash;
+                                slot.row = row;
+                                index->next_row[row] = UINT32_MAX;
+                                break;
+                        }
+                        if (slot.hash == hash) {
+                                const CSVStringView other = CSVIndexKey(index, slot.row);
+                                if ((other.length == key.length) && !memcmp(other.text, key.text, key.length)) {
+                                        index->next_row[row] = slot.row;
+                                        slot.row = row;
+                                        break;
+                                }
+                        }
+                        i = (i + 1) & index->mask;
+                }
+        }
+
+        index->ready.store(true, std::memory_order_release);
+}
+
+
+static void CSVIndexWait(CSVRowIndex* index) {
+        std::call_once(index->joined, [index]() {
+                if (index->worker.joinable()) {
+                        index->worker.join();
+                }
+        });
+        ASSERT(index->ready.load(std::memory_order_acquire));
+}
+
+
+static CSVRowIndex* CSV_BuildIndex(const CSVFile* csv, uint32_t column, bool build_in_background) {
+        ASSERT(column < csv->column_count);
+        ASSERT(csv->line_count <= (1u << 30));
+
+        // at most half full so probe sequences stay short
+        uint32_t slot_count = 16;
+        while (slot_count < csv->line_count * 2ull) {
+                slot_count *= 2;
+        }
+
+        CSVRowIndex* index = new CSVRowIndex;
+        index->csv = csv;
+        index->column = column;
+        index->mask = slot_count - 1;
+        index->slots = (CSVRowIndex::Slot*)malloc(slot_count * sizeof(CSVRowIndex::Slot));
+        index->next_row = (uint32_t*)malloc((csv->line_count + 1) * sizeof(uint32_t));
+        ASSERT(index->slots != NULL);
+        ASSERT(index->next_row != NULL);
+        memset(index->slots, 0xFF, slot_count * sizeof(CSVRowIndex::Slot));
+        index->ready.store(false, std::memory_order_relaxed);
+
+        if (build_in_background) {
+                index->worker = std::thread(CSVIndexBuild, index);
+        }
+        else {
+                CSVIndexBuild(index);
+        }
+
+        return index;
+}
+
+
+static bool CSV_IndexReady(const CSVRowIndex* index) {
+        return index->ready.load(std::memory_order_acquire);
+}
+
+
+static uint32_t CSV_FindRow(CSVRowIndex* index, const char* key) {
+        CSVIndexWait(index);
+
+        const uint32_t length = (uint32_t)strlen(key);
+        const uint32_t hash = CSVIndexHash(key, length);
+
+        for (uint32_t i = hash & index->mask; index->slots[i].row != UINT32_MAX; i = (i + 1) & index->mask) {
+                const auto& slot = index->slots[i];
+                if (slot.hash != hash) continue;
+
+                const CSVStringView other = CSVIndexKey(index, slot.row);
+                if ((other.length == length) && !memcmp(other.text, key, length)) {
+                        return slot.row;
+                }
+        }
+        return UINT32_MAX;
+}
+
+
+static uint32_t CSV_NextRow(CSVRowIndex* index, uint32_t row) {
+        CSVIndexWait(index);
+        ASSERT(row < index->csv->line_count);
+        return index->next_row[row];
+}
+
+
+static void CSV_FreeIndex(CSVRowIndex* index) {
+        CSVIndexWait(index);
+        free(index->slots);
+        free(index->next_row);
+        delete index;
+}
+
+
+struct CSVQueryResult {
+        const CSVFile* csv;
+        uint32_t* rows;
+        uint32_t row_count;
+        uint32_t* columns;
+        uint32_t column_count;
+};
+
+
+// a column parsed for filtering or sorting, only the rows still in the query are parsed
+// and they are packed: values[i] and errors[i] are for rows[i] of the query
+struct CSVQueryColumn {
+        CSVColumnType type;
+        void* values;
+        bool* errors;
+};
+
+
+// a filter value parsed as the type of its column
+union CSVQueryValue {
+        uint32_t u32;
+        int64_t s64;
+        float f32;
+        double f64;
+        bool b;
+        CSVStringView str;
+};
+
+
+static uint32_t CSVColumnTypeSize(CSVColumnType type) {
+        switch (type) {
+        case CSVColumn_U32: return sizeof(uint32_t);
+        case CSVColumn_S64: return sizeof(int64_t);
+        case CSVColumn_Float: return sizeof(float);
+        case CSVColumn_Double: return sizeof(double);
+        case CSVColumn_Bool: return sizeof(bool);
+        case CSVColumn_String: return sizeof(CSVStringView);
+        }
+        ASSERT(false && "Invalid CSVColumnType");
+        return 0;
+}
+
+
+static bool CSVQueryParseValue(CSVColumnType type, const char* text, CSVQueryValue* out) {
+        if (!text) return false;
+        switch (type) {
+        case CSVColumn_U32: return Parser->ParseU32(text, &out->u32, false);
+        case CSVColumn_S64: return Parser->ParseS64(text, &out->s64, false);
+        case CSVColumn_Float: return Parser->ParseFloat(text, &out->f32);
+        case CSVColumn_Double: return Parser->ParseDouble(text, &out->f64);
+        case CSVColumn_Bool: return Parser->ParseBool(text, &out->b);
+        case CSVColumn_String:
+                out->str.text = text;
+                out->str.length = (uint32_t)strlen(text);
+                return true;
+        }
+        ASSERT(false && "Invalid CSVColumnType");
+        return false;
+}
+
+
+static void CSVQueryLoadColumn(const CSVFile* csv, uint32_t column, CSVColumnType type, const uint32_t* rows, uint32_t count, CSVQueryColumn* out) {
+        out->type = type;
+        out->values = malloc((size_t)count * CSVColumnTypeSize(type) + 1);
+        out->errors = (bool*)malloc((size_t)count + 1);
+        ASSERT(out->values != NULL);
+        ASSERT(out->errors != NULL);
+
+        constexpr uint32_t min_rows_per_thread = 16 * 1024;
+        const uint32_t chunk_count = CSVThreadCount(count, min_rows_per_thread);
+        if (chunk_count < 2) {
+                CSVConvertColumn(csv, column, type, out->values, out->errors, rows, 0, count);
+                return;
+        }
+
+        const uint32_t chunk_rows = (count + chunk_count - 1) / chunk_count;
+        CSVParallelFor(chunk_count, [&](uint32_t i) {
+                const uint32_t begin = i * chunk_rows;
+                const uint32_t end = (count - begin > chunk_rows) ? begin + chunk_rows : count;
+                CSVConvertColumn(csv, column, type, out->values, out->errors, rows, begin, end);
+        });
+}
+
+
+static void CSVQueryFreeColumn(CSVQueryColumn* column) {
+        free(column->values);
+        free(column->errors);
+        memset(column, 0, sizeof(*column));
+}
+
+
+static inline int CSVViewCompare(CSVStringView a, CSVStringView b) {
+        const uint32_t length = (a.length < b.length) ? a.length : b.length;
+        const int ret = memcmp(a.text, b.text, length);
+        if (ret) return ret;
+        return (a.length < b.length) ? -1 : (a.length > b.length) ? 1 : 0;
+}
+
+
+// keep the rows that parsed and pass `pred` in order at the front of `rows`
+// there is no branch on the result so the loop runs at the same speed for any selectivity
+template<typename T, typename PRED>
+static uint32_t CSVFilterRows(uint32_t* rows, uint32_t count, const T* values, const bool* errors, const PRED& pred) {
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+                rows[kept] = rows[i];
+                kept += (!errors[i] && pred(values[i])) ? 1 : 0;
+        }
+        return kept;
+}
+
+
+template<typename T>
+static uint32_t CSVFilterNumbers(uint32_t* rows, uint32_t count, const T* values, const bool* errors, CSVCompare compare, T value) {
+        switch (compare) {
+        case CSVCompare_Equal: return CSVFilterRows(rows, count, values, errors, [value](T x) { return x == value; });
+        case CSVCompare_NotEqual: return CSVFilterRows(rows, count, values, errors, [value](T x) { return x != value; });
+        case CSVCompare_Less: return CSVFilterRows(rows, count, values, errors, [value](T x) { return x < value; });
+        case CSVCompare_LessEqual: return CSVFilterRows(rows, count, values, errors, [value](T x) { return x <= value; });
+        case CSVCompare_Greater: return CSVFilterRows(rows, count, values, errors, [value](T x) { return x > value; });
+        case CSVCompare_GreaterEqual: return CSVFilterRows(rows, count, values, errors, [value](T x) { return x >= value; });
+        case CSVCompare_Contains: break;
+        }
+        ASSERT(false && "Invalid CSVCompare for a number column");
+        return 0;
+}
+
+
+// a compare as the orderings that pass it, all ones or zero for less, equal, and greater
+struct CSVCompareLanes {
+        uint32_t less;
+        uint32_t equal;
+        uint32_t greater;
+};
+
+
+static CSVCompareLanes CSVLanesFor(CSVCompare compare) {
+        switch (compare) {
+        case CSVCompare_Equal: return { 0, ~0u, 0 };
+        case CSVCompare_NotEqual: return { ~0u, 0, ~0u };
+        case CSVCompare_Less: return { ~0u, 0, 0 };
+        case CSVCompare_LessEqual: return { ~0u, ~0u, 0 };
+        case CSVCompare_Greater: return { 0, 0, ~0u };
+        case CSVCompare_GreaterEqual: return { 0, ~0u, ~0u };
+        case CSVCompare_Contains: break;
+        }
+        ASSERT(false && "Invalid CSVCompare for a number column");
+        return { 0, 0, 0 };
+}
+
+
+// CSVFilterNumbers() for the types sse2 can compare, LANES values at a time
+// `block(values, &less, &equal, &greater)` sets bit j of each mask from values[j] and the
+// masks are combined with the lanes of the compare, so the loop branches on neither the
+// compare nor the result, only the rows left over at the end are compared one at a time
+template<uint32_t LANES, typename T, typename BLOCK>
+static uint32_t CSVFilterLanes(uint32_t* rows, uint32_t count, const T* values, const bool* errors, CSVCompare compare, T value, const BLOCK& block) {
+        const CSVCompareLanes select = CSVLanesFor(compare);
+        const __m128i zero = _mm_setzero_si128();
+        constexpr uint32_t lane_mask = (1u << LANES) - 1;
+
+        uint32_t kept = 0;
+        uint32_t i = 0;
+        for (; i + LANES <= count; i += LANES) {
+                uint32_t error_bytes = 0;
+                memcpy(&error_bytes, &errors[i], LANES);
+                const uint32_t parsed = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_cvtsi32_si128((int)error_bytes), zero));
+
+                uint32_t less, equal, greater;
+                block(&values[i], &less, &equal, &greater);
+                const uint32_t pass = parsed & lane_mask & ((less & select.less) | (equal & select.equal) | (greater & select.greater));
+
+                for (uint32_t j = 0; j < LANES; ++j) {
+                        rows[kept] = rows[i + j];
+                        kept += (pass >> j) & 1;
+                }
+        }
+        for (; i < count; ++i) {
+                const T x = values[i];
+                const uint32_t pass = (x < value) ? select.less : (x == value) ? select.equal : select.greater;
+                rows[kept] = rows[i];
+                kept += (uint32_t)!errors[i] & pass;
+        }
+        return kept;
+}
+
+
+// sse2 only has signed 32 bit compares, flipping the sign bit of both sides orders them as unsigned
+static uint32_t CSVFilterU32(uint32_t* rows, uint32_t count, const uint32_t* values, const bool* errors, CSVCompare compare, uint32_t value) {
+        const __m128i bias = _mm_set1_epi32(INT32_MIN);
+        const __m128i target = _mm_xor_si128(_mm_set1_epi32((int)value), bias);
+        return CSVFilterLanes<4>(rows, count, values, errors, compare, value, [&](const uint32_t* in, uint32_t* less, uint32_t* equal, uint32_t* greater) {
+                const __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in), bias);
+                *less = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(x, target)));
+                *equal = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, target)));
+                *greater = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(x, target)));
+        });
+}
+
+
+static uint32_t CSVFilterFloat(uint32_t* rows, uint32_t count, const float* values, const bool* errors, CSVCompare compare, float value) {
+        const __m128 target = _mm_set1_ps(value);
+        return CSVFilterLanes<4>(rows, count, values, errors, compare, value, [&](const float* in, uint32_t* less, uint32_t* equal, uint32_t* greater) {
+                const __m128 x = _mm_loadu_ps(in);
+                *less = (uint32_t)_mm_movemask_ps(_mm_cmplt_ps(x, target));
+                *equal = (uint32_t)_mm_movemask_ps(_mm_cmpeq_ps(x, target));
+                *greater = (uint32_t)_mm_movemask_ps(_mm_cmpgt_ps(x, target));
+        });
+}
+
+
+static uint32_t CSVFilterDouble(uint32_t* rows, uint32_t count, const double* values, const bool* errors, CSVCompare compare, double value) {
+        const __m128d target = _mm_set1_pd(value);
+        return CSVFilterLanes<2>(rows, count, values, errors, compare, value, [&](const double* in, uint32_t* less, uint32_t* equal, uint32_t* greater) {
+                const __m128d x = _mm_loadu_pd(in);
+                *less = (uint32_t)_mm_movemask_pd(_mm_cmplt_pd(x, target));
+                *equal = (uint32_t)_mm_movemask_pd(_mm_cmpeq_pd(x, target));
+                *greater = (uint32_t)_mm_movemask_pd(_mm_cmpgt_pd(x, target));
+        });
+}
+
+
+static uint32_t CSVFilterStrings(uint32_t* rows, uint32_t count, const CSVStringView* values, const bool* errors, CSVCompare compare, CSVStringView value) {
+        switch (compare) {
+        case CSVCompare_Equal: return CSVFilterRows(rows, count, values, errors, [value](CSVStringView x) {
+                        return (x.length == value.length) && (memcmp(x.text, value.text, x.length) == 0);
+                });
+        case CSVCompare_NotEqual: return CSVFilterRows(rows, count, values, errors, [value](CSVStringView x) {
+                        return (x.length != value.length) || (memcmp(x.text, value.text, x.length) != 0);
+                });
+        case CSVCompare_Less: return CSVFilterRows(rows, count, values, errors, [value](CSVStringView x) { return CSVViewCompare(x, value) < 0; });
+        case CSVCompare_LessEqual: return CSVFilterRows(rows, count, values, errors, [value](CSVStringView x) { return CSVViewCompare(x, value) <= 0; });
+        case CSVCompare_Greater: return CSVFilterRows(rows, count, values, errors, [value](CSVStringView x) { return CSVViewCompare(x, value) > 0; });
+        case CSVCompare_GreaterEqual: return CSVFilterRows(rows, count, values, errors, [value](CSVStringView x) { return CSVViewCompare(x, value) >= 0; });
+        case CSVCompare_Contains: return CSVFilterRows(rows, count, values, errors, [value](CSVStringView x) {
+                        // cells are always null terminated
+                        return strstr(x.text, value.text) != NULL;
+                });
+        }
+        ASSERT(false && "Invalid CSVCompare");
+        return 0;
+}
+
+
+// `rows`, the values, and the errors all start at the first row of the chunk
+static uint32_t CSVQueryFilterChunk(uint32_t* rows, uint32_t count, const CSVQueryColumn* column, uint32_t begin, CSVCompare compare, const CSVQueryValue* value) {
+        const bool* errors = column->errors + begin;
+        switch (column->type) {
+        case CSVColumn_U32: return CSVFilterU32(rows, count, (const uint32_t*)column->values + begin, errors, compare, value->u32);
+        case CSVColumn_S64: return CSVFilterNumbers(rows, count, (const int64_t*)column->values + begin, errors, compare, value->s64);
+        case CSVColumn_Float: return CSVFilterFloat(rows, count, (const float*)column->values + begin, errors, compare, value->f32);
+        case CSVColumn_Double: return CSVFilterDouble(rows, count, (const double*)column->values + begin, errors, compare, value->f64);
+        case CSVColumn_Bool: return CSVFilterNumbers(rows, count, (const bool*)column->values + begin, errors, compare, value->b);
+        case CSVColumn_String: return CSVFilterStrings(rows, count, (const CSVStringView*)column->values + begin, errors, compare, value->str);
+        }
+        ASSERT(false && "Invalid CSVColumnType");
+        return 0;
+}
+
+
+// each thread compacts its own slice of `rows`, then the slices are moved together
+static uint32_t CSVQueryFilterRows(uint32_t* rows, uint32_t count, const CSVQueryColumn* column, CSVCompare compare, const CSVQueryValue* value) {
+        constexpr uint32_t min_rows_per_thread = 64 * 1024;
+        const uint32_t chunk_count = CSVThreadCount(count, min_rows_per_thread);
+        if (chunk_count < 2) {
+                return CSVQueryFilterChunk(rows, count, column, 0, compare, value);
+        }
+
+        const uint32_t chunk_rows = (count + chunk_count - 1) / chunk_count;
+        uint32_t kept[16] = {};
+        CSVParallelFor(chunk_count, [&](uint32_t i) {
+                const uint32_t begin = i * chunk_rows;
+                const uint32_t end = (count - begin > chunk_rows) ? begin + chunk_rows : count;
+                kept[i] = CSVQueryFilterChunk(&rows[begin], end - begin, column, begin, compare, value);
+        });
+
+        uint32_t total = kept[0];
+        for (uint32_t i = 1; i < chunk_count; ++i) {
+                memmove(&rows[total], &rows[i * chunk_rows], kept[i] * sizeof(uint32_t));
+                total += kept[i];
+        }
+        return total;
+}
+
+
+template<typename T>
+static inline int CSVCompareValues(T a, T b) {
+        return (a < b) ? -1 : (b < a) ? 1 : 0;
+}
+
+
+// compare the rows at positions `a` and `b` of the query by one sort key, rows that failed
+// to parse sort after everything else in either direction
+// the parser never gives NaN (it does not accept "nan") so the numbers are totally ordered
+static int CSVQueryCompareRows(const CSVQueryColumn* column, bool descending, uint32_t a, uint32_t b) {
+        const bool missing_a = column->errors[a];
+        const bool missing_b = column->errors[b];
+
+        int ret = 0;
+        switch (column->type) {
+        case CSVColumn_U32: {
+                const auto values = (const uint32_t*)column->values;
+                ret = CSVCompareValues(values[a], values[b]);
+                break;
+        }
+        case CSVColumn_S64: {
+                const auto values = (const int64_t*)column->values;
+                ret = CSVCompareValues(values[a], values[b]);
+                break;
+        }
+        case CSVColumn_Float: {
+                const auto values = (const float*)column->values;
+                ret = CSVCompareValues(values[a], values[b]);
+                break;
+        }
+        case CSVColumn_Double: {
+                const auto values = (const double*)column->values;
+                ret = CSVCompareValues(values[a], values[b]);
+                break;
+        }
+        case CSVColumn_Bool: {
+                const auto values = (const bool*)column->values;
+                ret = CSVCompareValues(values[a], values[b]);
+                break;
+        }
+        case CSVColumn_String: {
+                const auto values = (const CSVStringView*)column->values;
+                ret = CSVViewCompare(values[a], values[b]);
+                break;
+        }
+        }
+
+        if (missing_a || missing_b) {
+                return (int)missing_a - (int)missing_b;
+        }
+        return (descending) ? -ret : ret;
+}
+
+
+// filters run one after another on the shrinking list of rows, each one parses its column
+// for the remaining rows into a packed array first so the compare loop is a straight pass
+// over the values, simd for u32, float, and double columns
+// sorting parses the key columns of the filtered rows the same way and sorts positions in
+// the row list, the list is in file order so ties fall back to the row number and a sort
+// with a limit gives the same rows as a full sort cut short
+static CSVQueryResult* CSV_Query(const CSVFile* csv, const CSVQuery* query) {
+        ASSERT(csv != NULL);
+        ASSERT(query != NULL);
+        ASSERT(query->filter_count == 0 || query->filters != NULL);
+        ASSERT(query->sort_count == 0 || query->sort != NULL);
+
+        // parse every filter value first so a bad value fails before any work is done
+        std::vector<CSVQueryValue> values(query->filter_count);
+        for (uint32_t i = 0; i < query->filter_count; ++i) {
+                const CSVQueryFilter* filter = &query->filters[i];
+                ASSERT(filter->column < csv->column_count);
+                ASSERT((filter->compare != CSVCompare_Contains || filter->type == CSVColumn_String) && "Contains is only for string columns");
+                if (!CSVQueryParseValue(filter->type, filter->value, &values[i])) {
+                        DEBUG("Query filter %u value '%s' could not be parsed", i, (filter->value) ? filter->value : "(null)");
+                        return NULL;
+                }
+        }
+        for (uint32_t i = 0; i < query->sort_count; ++i) {
+                ASSERT(query->sort[i].column < csv->column_count);
+        }
+
+        const uint32_t first_row = (query->first_row < csv->line_count) ? query->first_row : csv->line_count;
+        uint32_t count = csv->line_count - first_row;
+        auto rows = (uint32_t*)malloc(((size_t)count + 1) * sizeof(uint32_t));
+        ASSERT(rows != NULL);
+        for (uint32_t i = 0; i < count; ++i) {
+                rows[i] = first_row + i;
+        }
+
+        for (uint32_t i = 0; (i < query->filter_count) && (count > 0); ++i) {
+                const CSVQueryFilter* filter = &query->filters[i];
+                CSVQueryColumn column;
+                CSVQueryLoadColumn(csv, filter->column, filter->type, rows, count, &column);
+                count = CSVQueryFilterRows(rows, count, &column, filter->compare, &values[i]);
+                CSVQueryFreeColumn(&column);
+        }
+
+        const uint32_t limit = (query->limit && query->limit < count) ? query->limit : count;
+
+        if (query->sort_count && count > 1) {
+                std::vector<CSVQueryColumn> keys(query->sort_count);
+                for (uint32_t i = 0; i < query->sort_count; ++i) {
+                        CSVQueryLoadColumn(csv, query->sort[i].column, query->sort[i].type, rows, count, &keys[i]);
+                }
+
+                std::vector<uint32_t> order(count);
+                for (uint32_t i = 0; i < count; ++i) {
+                        order[i] = i;
+                }
+
+                const auto less = [&](uint32_t a, uint32_t b) {
+                        for (uint32_t i = 0; i < query->sort_count; ++i) {
+                                const int ret = CSVQueryCompareRows(&keys[i], query->sort[i].descending, a, b);
+                                if (ret) return ret < 0;
+                        }
+                        return a < b;
+                };
+                if (limit < count) {
+                        std::partial_sort(order.begin(), order.begin() + limit, order.end(), less);
+                }
+                else {
+                        std::sort(order.begin(), order.end(), less);
+                }
+
+                for (uint32_t i = 0; i < limit; ++i) {
+                        order[i] = rows[order[i]];
+                }
+                memcpy(rows, order.data(), limit * sizeof(uint32_t));
+
+                for (auto& key : keys) {
+                        CSVQueryFreeColumn(&key);
+                }
+        }
+        count = limit;
+
+        const uint32_t column_count = (query->columns) ? query->column_count : csv->column_count;
+        auto columns = (uint32_t*)malloc(((size_t)column_count + 1) * sizeof(uint32_t));
+        ASSERT(columns != NULL);
+        for (uint32_t i = 0; i < column_count; ++i) {
+                columns[i] = (query->columns) ? query->columns[i] : i;
+                ASSERT(columns[i] < csv->column_count);
+        }
+
+        auto ret = (CSVQueryResult*)malloc(sizeof(CSVQueryResult));
+        ASSERT(ret != NULL);
+        ret->csv = csv;
+        ret->rows = rows;
+        ret->row_count = count;
+        ret->columns = columns;
+        ret->column_count = column_count;
+        return ret;
+}
+
+
+static uint32_t CSV_QueryRowCount(const CSVQueryResult* result) {
+        return result->row_count;
+}
+
+
+static const uint32_t* CSV_QueryRows(const CSVQueryResult* result) {
+        return result->rows;
+}
+
+
+static const char* CSV_QueryCell(const CSVQueryResult* result, uint32_t row, uint32_t column) {
+        ASSERT(row < result->row_count);
+        ASSERT(column < result->column_count);
+        const CSVFile* csv = result->csv;
+        return CSVCellText(csv, result->rows[row] * csv->column_count + result->columns[column]);
+}
+
+
+static void CSV_FreeQuery(CSVQueryResult* result) {
+        free(result->rows);
+        free(result->columns);
+        free(result);
+}
+
+
+// the streaming reader keeps the unfinished row at the front of a block buffer and
+// tokenizes from the start of that row every time more of the file is read in,
+// the start of a row is never inside quotes so no other state needs to carry over
+struct CSVStream {
+        char* buffer;
+        uint32_t capacity; // the allocation has room for a null character after this
+        uint32_t data_size;
+        bool at_eof;
+
+        uint32_t column_count;
+        uint64_t row;
+
+        // for the row being tokenized
+        std::vector<uint32_t> cells;
+        std::vector<uint32_t> terminators;
+        std::vector<CSVStringView> views;
+};
+
+
+enum CSVStreamResult {
+        CSVStream_NeedData,
+        CSVStream_Done,
+        CSVStream_Error,
+};
+
+
+// CSVCellStart() for the part of the file in the stream buffer
+// returns 1 if the cell was found, 0 if the file ends first, or -1 if more data is needed
+static int CSVStreamCellStart(const CSVStream* stream, uint32_t pos, uint32_t* out_cell) {
+        const char* const buffer = stream->buffer;
+        const uint32_t size = stream->data_size;
+
+        uint32_t p = pos;
+        while ((p < size) && (buffer[p] == '"')) ++p;
+        if (p >= size) return (stream->at_eof) ? 0 : -1;
+
+        if ((buffer[p] == '\r') && !((p - pos) & 1)) {
+                if ((p + 1 >= size) && !stream->at_eof) return -1;
+                if (buffer[p + 1] == '\n') ++p;
+        }
+
+        *out_cell = p;
+        return 1;
+}
+
+
+// null terminate the cells of a finished row and send it to the callback
+static bool CSVStreamEmitRow(CSVStream* stream, CALLBACK_CSVROW callback, uintptr_t userdata) {
+        for (const auto pos : stream->terminators) {
+                stream->buffer[pos] = '\0';
+        }
+
+        const uint32_t count = (uint32_t)stream->cells.size();
+        stream->views.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+                const char* const text = &stream->buffer[stream->cells[i]];
+                stream->views[i].text = text;
+                stream->views[i].length = (uint32_t)strlen(text);
+        }
+
+        stream->cells.clear();
+        stream->terminators.clear();
+        return callback(userdata, stream->row++, stream->views.data(), count);
+}
+
+
+// tokenize the stream buffer from `*in_out_row_start`, which is moved past every row sent to the callback
+// same logic as CSVTokenize() except that the separators are only written after a row is
+// finished because an unfinished row is tokenized again when more data is read
+static CSVStreamResult CSVStreamScan(CSVStream* stream, uint32_t* in_out_row_start, CALLBACK_CSVROW callback, uintptr_t userdata) {
+        const char* const buffer = stream->buffer;
+        const uint32_t size = stream->data_size;
+        const bool clmul = CSVHasCarrylessMultiply();
+
+        uint32_t row_start = *in_out_row_start;
+        uint32_t columns = 0;
+        uint64_t inside_carry = 0;
+        uint32_t cell;
+
+        stream->cells.clear();
+        stream->terminators.clear();
+
+        int found = CSVStreamCellStart(stream, row_start, &cell);
+        if (found < 0) return CSVStream_NeedData;
+        if (found) stream->cells.push_back(cell);
+
+        for (uint32_t base = row_start; base < size; base += 64) {
+                const uint32_t remain = size - base;
+                CSVBlockMasks masks;
+                if (remain >= 64) {
+                        CSVReadBlockMasks(buffer + base, &masks);
+                }
+                else {
+                        alignas(16) char tail[64] = {};
+                        memcpy(tail, buffer + base, remain);
+                        CSVReadBlockMasks(tail, &masks);
+                }
+
+                const uint64_t inside = CSVPrefixXor(masks.quote, clmul) ^ inside_carry;
+                inside_carry = (uint64_t)((int64_t)inside >> 63);
+
+                uint64_t separators = (masks.comma | masks.newline) & ~inside;
+                while (separators) {
+                        unsigned long bit;
+                        _BitScanForward64(&bit, separators);
+                        separators &= separators - 1;
+
+                        const uint32_t pos = base + bit;
+                        stream->terminators.push_back(pos);
+
+                        if ((masks.comma >> bit) & 1) {
+                                ++columns;
+                        }
+                        else {
+                                // the carriage return of a CRLF, the row start follows a newline so it is never one
+                                if ((pos > row_start) && (buffer[pos - 1] == '\r')) {
+                                        stream->terminators.push_back(pos - 1);
+                                }
+
+                                if (!columns) continue; //a newline with no columns is ignored
+
+                                ++columns;
+                                if (!stream->column_count) {
+                                        stream->column_count = columns;
+                                }
+                                if (columns != stream->column_count) {
+                                        DEBUG("Column count mismatch: %u != %u", columns, stream->column_count);
+                                        return CSVStream_Error;
+                                }
+                                columns = 0;
+
+                                row_start = pos + 1;
+                                *in_out_row_start = row_start;
+                                if (!CSVStreamEmitRow(stream, callback, userdata)) {
+                                        return CSVStream_Done;
+                                }
+                        }
+
+                        found = CSVStreamCellStart(stream, pos + 1, &cell);
+                        if (found < 0) return CSVStream_NeedData;
+                        if (found) stream->cells.push_back(cell);
+                }
+        }
+        if (!stream->at_eof) {
+                return CSVStream_NeedData;
+        }
+
+        if (inside_carry) {
+                DEBUG("Unterminated quote");
+                return CSVStream_Error;
+        }
+
+        // the last row did not end in a newline, CSV_Load() only checks the total cell count here
+        const uint32_t pending = (uint32_t)stream->cells.size();
+        const uint32_t expected = (columns) ? stream->column_count : 0;
+        if (pending != expected) {
+                DEBUG("Cell count mismatch: cell_size(%u) != cell_count(%u)", pending, expected);
+                return CSVStream_Error;
+        }
+        if (pending) {
+                *in_out_row_start = size;
+                CSVStreamEmitRow(stream, callback, userdata);
+        }
+        return CSVStream_Done;
+}
+
+
+static bool CSV_Stream(const char* filename, CALLBACK_CSVROW callback, uintptr_t userdata) {
+        ASSERT(callback != NULL);
+
+        char path[MAX_PATH];
+        GetPathInDllDir(path, filename);
+
+        DEBUG("Filename: %s", path);
+        const auto hfile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hfile == INVALID_HANDLE_VALUE) {
+                return false;
+        }
+
+        // a row longer than the block grows the buffer up to the limit
+        // a newline on a line without commas does not end the row, so without the limit
+        // a file with no commas at all would be read into the buffer in one piece
+        constexpr uint32_t block_size = 1024 * 1024;
+        constexpr uint32_t max_row_size = 64 * 1024 * 1024;
+
+        CSVStream stream{};
+        stream.capacity = block_size;
+        stream.buffer = (char*)malloc(stream.capacity + 1);
+        ASSERT(stream.buffer != NULL);
+
+        uint32_t row_start = 0;
+        CSVStreamResult result = CSVStream_NeedData;
+        while (result == CSVStream_NeedData) {
+                if (row_start) {
+                        stream.data_size -= row_start;
+                        memmove(stream.buffer, stream.buffer + row_start, stream.data_size);
+                        row_start = 0;
+                }
+                else if (stream.data_size == stream.capacity) {
+                        if (stream.capacity >= max_row_size) {
+                                DEBUG("Row %llu is longer than %u bytes", (unsigned long long)stream.row, max_row_size);
+                                result = CSVStream_Error;
+                                break;
+                        }
+                        stream.capacity *= 2;
+                        stream.buffer = (char*)realloc(stream.buffer, stream.capacity + 1);
+                        ASSERT(stream.buffer != NULL);
+                }
+
+                const DWORD wanted = stream.capacity - stream.data_size;
+                DWORD bytes_read = 0;
+                if (!ReadFile(hfile, stream.buffer + stream.data_size, wanted, &bytes_read, NULL)) {
+                        DEBUG("ReadFile failed");
+                        result = CSVStream_Error;
+                        break;
+                }
+                stream.data_size += bytes_read;
+                stream.at_eof = (bytes_read < wanted);
+                stream.buffer[stream.data_size] = '\0';
+
+                result = CSVStreamScan(&stream, &row_start, callback, userdata);
+        }
+
+        CloseHandle(hfile);
+        free(stream.buffer);
+        return (result == CSVStream_Done);
+}
+
+
+// cells are appended to `buffer`, a full buffer is written to the file either right away or
+// on a background thread while the caller fills the second buffer
+struct CSVWriter {
+        HANDLE file;
+        char* buffer;
+        char* flush_buffer; // only used when flushing in the background
+        uint32_t used;
+        bool background;
+        bool row_started; // the next cell on this row needs a comma before it
+
+        // set by the flush thread, only read after it is joined
+        bool failed;
+        std::thread flusher;
+};
+
+
+static constexpr uint32_t CSVWriterBufferSize = 4 * 1024 * 1024;
+
+
+static void CSVWriterFlush(CSVWriter* writer) {
+        if (writer->used == 0) return;
+
+        const uint32_t size = writer->used;
+        writer->used = 0;
+
+        if (!writer->background) {
+                if (!CSVWriteAll(writer->file, writer->buffer, size)) {
+                        writer->failed = true;
+                }
+                return;
+        }
+
+        if (writer->flusher.joinable()) {
+                writer->flusher.join();
+        }
+        char* const full = writer->buffer;
+        writer->buffer = writer->flush_buffer;
+        writer->flush_buffer = full;
+        writer->flusher = std::thread([writer, full, size]() {
+                if (!CSVWriteAll(writer->file, full, size)) {
+                        writer->failed = true;
+                }
+        });
+}
+
+
+static void CSVWriterAppend(CSVWriter* writer, const char* data, uint32_t size) {
+        while (size) {
+                if (writer->used == CSVWriterBufferSize) {
+                        CSVWriterFlush(writer);
+                }
+                const uint32_t space = CSVWriterBufferSize - writer->used;
+                const uint32_t count = (size < space) ? size : space;
+                memcpy(writer->buffer + writer->used, data, count);
+                writer->used += count;
+                data += count;
+                size -= count;
+        }
+}
+
+
+// a cell has to be quoted if it has a comma, a quote, or a line break anywhere in it
+static bool CSVNeedsQuotes(const char* text, uint32_t length) {
+        const __m128i comma = _mm_set1_epi8(',');
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i carriage_return = _mm_set1_epi8('\r');
+
+        uint32_t i = 0;
+        for (; i + 16 <= length; i += 16) {
+                const __m128i block = _mm_loadu_si128((const __m128i*)(text + i));
+                const __m128i separators = _mm_or_si128(_mm_cmpeq_epi8(block, comma), _mm_cmpeq_epi8(block, quote));
+                const __m128i line_breaks = _mm_or_si128(_mm_cmpeq_epi8(block, newline), _mm_cmpeq_epi8(block, carriage_return));
+                if (_mm_movemask_epi8(_mm_or_si128(separators, line_breaks))) {
+                        return true;
+                }
+        }
+        for (; i < length; ++i) {
+                const char c = text[i];
+                if ((c == ',') || (c == '"') || (c == '\n') || (c == '\r')) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+
+// start a cell, the text of the cell is appended right after
+static inline void CSVWriterBeginCell(CSVWriter* writer) {
+        if (writer->row_started) {
+                CSVWriterAppend(writer, ",", 1);
+        }
+        writer->row_started = true;
+}
+
+
+static CSVWriter* CSV_OpenWriter(const char* filename, bool flush_in_background) {
+        char path[MAX_PATH];
+        GetPathInDllDir(path, filename);
+
+        DEBUG("Filename: %s", path);
+        const auto hfile = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hfile == INVALID_HANDLE_VALUE) {
+                return NULL;
+        }
+
+        const auto ret = new CSVWriter{};
+        ret->file = hfile;
+        ret->background = flush_in_background;
+        ret->buffer = (char*)malloc(CSVWriterBufferSize);
+        ASSERT(ret->buffer != NULL);
+        if (flush_in_background) {
+                ret->flush_buffer = (char*)malloc(CSVWriterBufferSize);
+                ASSERT(ret->flush_buffer != NULL);
+        }
+        return ret;
+}
+
+
+// quoted cells double every quote inside them
+static void CSV_WriteCell(CSVWriter* writer, const char* text) {
+        ASSERT(text != NULL);
+        const uint32_t length = (uint32_t)strlen(text);
+
+        // an empty first cell is quoted, a row of just that cell would be a blank line
+        // and blank lines are skipped when the file is read
+        const bool first_cell = !writer->row_started;
+        CSVWriterBeginCell(writer);
+        if (!CSVNeedsQuotes(text, length)) {
+                if ((length == 0) && first_cell) {
+                        CSVWriterAppend(writer, "\"\"", 2);
+                }
+                CSVWriterAppend(writer, text, length);
+                return;
+        }
+
+        CSVWriterAppend(writer, "\"", 1);
+        const char* const end = text + length;
+        while (text < end) {
+                const auto quote = (const char*)memchr(text, '"', end - text);
+                const char* const run_end = (quote) ? quote + 1 : end;
+                CSVWriterAppend(writer, text, (uint32_t)(run_end - text));
+                if (quote) {
+                        CSVWriterAppend(writer, "\"", 1);
+                }
+                text = run_end;
+        }
+        CSVWriterAppend(writer, "\"", 1);
+}
+
+
+static void CSV_WriteU64(CSVWriter* writer, uint64_t value) {
+        char text[24];
+        const uint32_t length = FormatU64(value, text, sizeof(text));
+        CSVWriterBeginCell(writer);
+        CSVWriterAppend(writer, text, length);
+}
+
+
+static void CSV_WriteS64(CSVWriter* writer, int64_t value) {
+        char text[24];
+        const uint32_t length = FormatS64(value, text, sizeof(text));
+        CSVWriterBeginCell(writer);
+        CSVWriterAppend(writer, text, length);
+}
+
+
+// the fewest digits that ParseFloat and ParseDouble read back as the same value
+static void CSV_WriteFloat(CSVWriter* writer, float value) {
+        char text[32];
+        const uint32_t length = FormatFloat(value, text, sizeof(text));
+        CSVWriterBeginCell(writer);
+        CSVWriterAppend(writer, text, length);
+}
+
+
+static void CSV_WriteDouble(CSVWriter* writer, double value) {
+        char text[32];
+        const uint32_t length = FormatDouble(value, text, sizeof(text));
+        CSVWriterBeginCell(writer);
+        CSVWriterAppend(writer, text, length);
+}
+
+
+// written as 1 or 0 to match ParseBool
+static void CSV_WriteBool(CSVWriter* writer, bool value) {
+        CSVWriterBeginCell(writer);
+        CSVWriterAppend(writer, (value) ? "1" : "0", 1);
+}
+
+
+static void CSV_EndRow(CSVWriter* writer) {
+        CSVWriterAppend(writer, "\n", 1);
+        writer->row_started = false;
+}
+
+
+static bool CSV_CloseWriter(CSVWriter* writer) {
+        CSVWriterFlush(writer);
+        if (writer->flusher.joinable()) {
+                writer->flusher.join();
+        }
+
+        const bool ok = !writer->failed;
+        if (!ok) {
+                DEBUG("Could not write the whole csv file");
+        }
+
+        CloseHandle(writer->file);
+        free(writer->buffer);
+        free(writer->flush_buffer);
+        delete writer;
+        return ok;
+}
+
+
+#ifdef MODMENU_DEBUG
+// debug only: write a few hundred megabytes of csv with the writer, then time every way of
+// reading it back in MB/s of file text, the loads must all give the same cells
+// results go to the debug log, the test renderer runs this with F5
+extern void CSVBenchmark() {
+        constexpr const char* filename = "csv_benchmark.csv";
+        // about 55 bytes per row, 384 MB of text
+        constexpr uint32_t row_count = 7 * 1024 * 1024;
+
+        using clock = std::chrono::steady_clock;
+        const auto now = []() -> clock::time_point {
+                return clock::now();
+        };
+        const auto seconds = [&](clock::time_point start) -> double {
+                return std::chrono::duration<double>(now() - start).count();
+        };
+
+        uint32_t errors = 0;
+        uint64_t rng = 0x9E3779B97F4A7C15;
+        const auto random = [&]() -> uint32_t {
+                rng ^= rng << 13;
+                rng ^= rng >> 7;
+                rng ^= rng << 17;
+                return (uint32_t)rng;
+        };
+
+        // an id, a name that is quoted with an escaped quote on every 8th row, a float, a double, and a bool
+        auto start = now();
+        CSVWriter* const writer = CSV_OpenWriter(filename, true);
+        if (!writer) {
+                DEBUG("Could not write %s", filename);
+                return;
+        }
+        char name[64];
+        for (uint32_t row = 0; row < row_count; ++row) {
+                if (row & 7) {
+                        snprintf(name, sizeof(name), "item_%u", row);
+                }
+                else {
+                        snprintf(name, sizeof(name), "big, \"rare\" item %u", row);
+                }
+                CSV_WriteU64(writer, row);
+                CSV_WriteCell(writer, name);
+                CSV_WriteFloat(writer, (float)(random() % 1000000) / 64.f);
+                CSV_WriteDouble(writer, (double)random() / 3.);
+                CSV_WriteBool(writer, (random() & 1) != 0);
+                CSV_EndRow(writer);
+        }
+        if (!CSV_CloseWriter(writer)) {
+                DEBUG("Could not write %s", filename);
+                return;
+        }
+        const double write_time = seconds(start);
+
+        char path[MAX_PATH];
+        GetPathInDllDir(path, filename);
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attributes)) {
+                DEBUG("Could not read the size of %s", path);
+                return;
+        }
+        const double megabytes = attributes.nFileSizeLow / (1024. * 1024.);
+        DEBUG("CSV benchmark file: %u rows, %.1f MB, written at %.1f MB/s", row_count, megabytes, megabytes / write_time);
+
+        // every load is compared to the plain load
+        start = now();
+        CSVFile* const reference = CSV_LoadEx(filename, CSVLoad_Default);
+        const double default_time = seconds(start);
+        if (!reference) {
+                DEBUG("Could not load %s", filename);
+                DeleteFileA(path);
+                return;
+        }
+        if ((reference->line_count != row_count) || (reference->column_count != 5)) {
+                DEBUG("Loaded %u lines and %u columns, expected %u and 5", reference->line_count, reference->column_count, row_count);
+                ++errors;
+        }
+        DEBUG("CSV load default: %.1f MB/s", megabytes / default_time);
+
+        const auto same_cells = [&](const CSVFile* csv) -> bool {
+                return (csv->line_count == reference->line_count) &&
+                        (csv->column_count == reference->column_count) &&
+                        !memcmp(csv->cells, reference->cells, reference->cell_count * sizeof(uint32_t));
+        };
+
+        const struct {
+                uint32_t flags;
+                const char* name;
+        } modes[] = {
+                { CSVLoad_Parallel, "parallel" },
+                { CSVLoad_MemoryMapped, "mapped" },
+                { CSVLoad_MemoryMapped | CSVLoad_Parallel, "mapped + parallel" },
+                { CSVLoad_Parallel | CSVLoad_UseIndex, "parallel, writing the index" },
+                { CSVLoad_Parallel | CSVLoad_UseIndex, "from the index" },
+                { CSVLoad_MemoryMapped | CSVLoad_UseIndex, "mapped, from the index" },
+        };
+        for (const auto& mode : modes) {
+                start = now();
+                CSVFile* const csv = CSV_LoadEx(filename, mode.flags);
+                const double load_time = seconds(start);
+                if (!csv) {
+                        DEBUG("CSV load %s: failed", mode.name);
+                        ++errors;
+                        continue;
+                }
+                if (!same_cells(csv)) {
+                        DEBUG("CSV load %s: the cells are different", mode.name);
+                        ++errors;
+                }
+                DEBUG("CSV load %s: %.1f MB/s", mode.name, megabytes / load_time);
+                CSV_Close(csv);
+        }
+
+        // the unescaped loads are checked against the names that were written, and the loads
+        // from the index written by an unescaped load against the first unescaped load
+        const struct {
+                uint32_t flags;
+                const char* name;
+        } unescape_modes[] = {
+                { CSVLoad_Parallel | CSVLoad_Unescape, "parallel + unescape" },
+                { CSVLoad_Parallel | CSVLoad_Unescape | CSVLoad_UseIndex, "parallel + unescape, writing the index" },
+                { CSVLoad_Parallel | CSVLoad_Unescape | CSVLoad_UseIndex, "unescape from the index" },
+                { CSVLoad_MemoryMapped | CSVLoad_Unescape | CSVLoad_UseIndex, "mapped + unescape, from the index" },
+        };
+        CSVFile* unescaped = NULL;
+        for (const auto& mode : unescape_modes) {
+                start = now();
+                CSVFile* const csv = CSV_LoadEx(filename, mode.flags);
+                const double load_time = seconds(start);
+                if (!csv) {
+                        DEBUG("CSV load %s: failed", mode.name);
+                        ++errors;
+                        continue;
+                }
+                for (uint32_t row = 0; row < csv->line_count; row += 4099) {
+                        if (row & 7) {
+                                snprintf(name, sizeof(name), "item_%u", row);
+                        }
+                        else {
+                                snprintf(name, sizeof(name), "big, \"rare\" item %u", row);
+                        }
+                        if (strcmp(CSV_ReadCell(csv, row, 1), name)) {
+                                ++errors;
+                        }
+                }
+                if (!unescaped) {
+                        unescaped = csv;
+                }
+                else {
+                        const bool same = (csv->cell_count == unescaped->cell_count) &&
+                                !memcmp(csv->cells, unescaped->cells, csv->cell_count * sizeof(uint32_t)) &&
+                                !memcmp(csv->cell_lengths, unescaped->cell_lengths, csv->cell_count * sizeof(uint32_t));
+                        if (!same) {
+                                DEBUG("CSV load %s: the cells are different", mode.name);
+                                ++errors;
+                        }
+                }
+                DEBUG("CSV load %s: %.1f MB/s", mode.name, megabytes / load_time);
+                if (csv != unescaped) CSV_Close(csv);
+        }
+        if (unescaped) CSV_Close(unescaped);
+
+        // the typed column reads, in MB/s of the whole file
+        const auto values = malloc(row_count * sizeof(CSVStringView));
+        ASSERT(values != NULL);
+        const struct {
+                uint32_t column;
+                CSVColumnType type;
+                const char* name;
+        } columns[] = {
+                { 0, CSVColumn_U32, "u32" },
+                { 1, CSVColumn_String, "string" },
+                { 2, CSVColumn_Float, "float" },
+                { 3, CSVColumn_Double, "double" },
+                { 4, CSVColumn_Bool, "bool" },
+        };
+        for (const auto& column : columns) {
+                start = now();
+                const uint32_t failed = CSV_ReadColumn(reference, column.column, column.type, values, NULL);
+                const double read_time = seconds(start);
+                if (failed) {
+                        DEBUG("CSV read column %s: %u rows failed", column.name, failed);
+                        ++errors;
+                }
+                DEBUG("CSV read column %s: %.1f MB/s", column.name, megabytes / read_time);
+
+                // the next column reuses the buffer, the ids are checked right away
+                if (column.type != CSVColumn_U32) continue;
+                for (uint32_t row = 0; row < row_count; ++row) {
+                        if (((const uint32_t*)values)[row] != row) {
+                                DEBUG("CSV read column u32: row %u is %u", row, ((const uint32_t*)values)[row]);
+                                ++errors;
+                                break;
+                        }
+                }
+        }
+        free(values);
+
+        uint64_t streamed = 0;
+        start = now();
+        const bool stream_ok = CSV_Stream(filename, [](uintptr_t userdata, uint64_t row, const CSVStringView* cells, uint32_t cell_count) -> bool {
+                (void)row;
+                (void)cells;
+                *(uint64_t*)userdata += cell_count;
+                return true;
+        }, (uintptr_t)&streamed);
+        const double stream_time = seconds(start);
+        if (!stream_ok || (streamed != reference->cell_count)) {
+                DEBUG("CSV stream: %llu cells, expected %u", (unsigned long long)streamed, reference->cell_count);
+                ++errors;
+        }
+        DEBUG("CSV stream: %.1f MB/s", megabytes / stream_time);
+
+        CSV_Close(reference);
+
+        char index_path[MAX_PATH];
+        uint64_t file_time;
+        if (CSVIndexPath(filename, index_path, &file_time)) {
+                DeleteFileA(index_path);
+        }
+        DeleteFileA(path);
+
+        DEBUG("CSV benchmark: %u errors", errors);
 }
+#endif
 
 
 extern const struct csv_api_t* GetCSVAPI() {
@@ -214,6 +2443,31 @@ extern const struct csv_api_t* GetCSVAPI() {
                 CSV_Close,
                 CSV_Info,
                 CSV_ReadCell,
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+                CSV_LoadEx,
+                CSV_ReadColumn,
+                CSV_Stream,
+                CSV_BuildIndex,
+                CSV_IndexReady,
+                CSV_FindRow,
+                CSV_NextRow,
+                CSV_FreeIndex,
+                CSV_ReadCellView,
+                CSV_Query,
+                CSV_QueryRowCount,
+                CSV_QueryRows,
+                CSV_QueryCell,
+                CSV_FreeQuery,
+                CSV_OpenWriter,
+                CSV_WriteCell,
+                CSV_WriteU64,
+                CSV_WriteS64,
+                CSV_WriteFloat,
+                CSV_WriteDouble,
+                CSV_WriteBool,
+                CSV_EndRow,
+                CSV_CloseWriter,
+#endif
         };
         return &CSVAPI;
 }
@@ -1,3 +1,9 @@
 #pragma once
 
-extern const struct csv_api_t* GetCSVAPI();
\ No newline at end of file
+#include "main.h"
+
+extern const struct csv_api_t* GetCSVAPI();
+
+#ifdef MODMENU_DEBUG
+extern void CSVBenchmark();
+#endif
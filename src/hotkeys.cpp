@@ -99,11 +99,11 @@ static void rebuild_hotkey_cache() {
         ActiveHotkeys.clear();
         std::sort(AllHotkeys.begin(), AllHotkeys.end());
 
-        ConfigSetMod("(hotkeys)");
+        // this runs outside of the config callbacks too, so name the mod explicitly
         for (unsigned i = 0; i < AllHotkeys.size(); ++i) {
                 const auto h = &AllHotkeys[i];
                 snprintf(tmp_buffer, sizeof(tmp_buffer), "%s-%s", CallbackGetName(h->owner), h->name);
-                Config->ConfigU32(ConfigAction_Read, tmp_buffer, &h->set_key);
+                ConfigReadU32("(hotkeys)", tmp_buffer, &h->set_key);
                 if (h->set_key) {
                         ActiveHotkeys[h->set_key] = i;
                 }
@@ -227,6 +227,11 @@ extern void draw_hotkeys_tab() {
 }
 
 
+extern void HotkeyReloadSettings() {
+        cache_rebuild_needed = true;
+}
+
+
 extern void HotkeySaveSettings() {
         if (cache_rebuild_needed) {
                 rebuild_hotkey_cache();
@@ -7,4 +7,5 @@
 extern void draw_hotkeys_tab();
 extern bool HotkeyReceiveKeypress(unsigned vk_key); // true if hotkey was activated
 extern void HotkeySaveSettings(); // call when normal settings are saved
+extern void HotkeyReloadSettings(); // call when the settings file was reloaded
 extern void HotkeyRequestNewHotkey(RegistrationHandle owner, const char* name, uintptr_t userdata, unsigned forced_hotkey);
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+// the msvc intrinsics used by the modules that do not depend on windows (parser, config_format)
+// on gcc and clang they are implemented with builtins so those modules also build on linux,
+// see tools/harness.cpp
+
+#ifdef _MSC_VER
+#include <intrin.h>
+
+#define NO_SANITIZE_ADDRESS
+#else
+#include <stdint.h>
+#include <x86intrin.h>
+
+static inline unsigned char _BitScanForward(unsigned long* index, unsigned long mask) {
+        if (!(uint32_t)mask) return 0;
+        *index = (unsigned long)__builtin_ctz((uint32_t)mask);
+        return 1;
+}
+
+static inline unsigned char _BitScanReverse(unsigned long* index, unsigned long mask) {
+        if (!(uint32_t)mask) return 0;
+        *index = 31ul - (unsigned long)__builtin_clz((uint32_t)mask);
+        return 1;
+}
+
+static inline unsigned char _BitScanForward64(unsigned long* index, uint64_t mask) {
+        if (!mask) return 0;
+        *index = (unsigned long)__builtin_ctzll(mask);
+        return 1;
+}
+
+static inline unsigned char _BitScanReverse64(unsigned long* index, uint64_t mask) {
+        if (!mask) return 0;
+        *index = 63ul - (unsigned long)__builtin_clzll(mask);
+        return 1;
+}
+
+static inline uint64_t _umul128(uint64_t a, uint64_t b, uint64_t* high) {
+        const unsigned __int128 product = (unsigned __int128)a * b;
+        *high = (uint64_t)(product >> 64);
+        return (uint64_t)product;
+}
+
+// the block loads that read past the end of a string (but never past the end of its page)
+// are on purpose, keep AddressSanitizer builds of the harness from reporting them
+#define NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#endif
@@ -1,13 +1,21 @@
 #include "main.h"
 
 #include <cstring>
+#include <deque>
 #include <string>
 #include <vector>
 
 
+// lines are stored back to back in `buffer`, each followed by a null terminator
+// offsets are logical: they keep counting up as old lines are dropped from the front,
+// so dropping a line never has to touch the offsets of the lines after it
 struct LogBuffer {
 	std::string buffer;
-	std::vector<uint32_t> lines;
+	std::deque<uint64_t> lines;	// logical offset of each line
+	uint64_t buffer_start{0};	// logical offset of buffer[0]
+	uint64_t first_line{0};		// number of lines dropped before lines[0]
+	uint32_t max_bytes{0};		// 0 = no limit
+	uint32_t max_lines{0};		// 0 = no limit
 	const char* name{nullptr};
 	FILE* logfile{nullptr};
 };
@@ -45,10 +53,17 @@ static const char* LogBufferGetName(LogBufferHandle handle) {
 }
 
 
-static uint32_t LogBufferGetSize(LogBufferHandle handle) {
+// bytes used by the lines still in the buffer
+static uint64_t LogBufferLiveBytes(const LogBuffer& l) {
+	if (l.lines.empty()) return 0;
+	return l.buffer_start + l.buffer.size() - l.lines.front();
+}
+
+
+static uint64_t LogBufferGetSize(LogBufferHandle handle) {
 	ASSERT(handle != 0);
 	ASSERT(handle < Logs.size());
-	return (uint32_t)Logs[handle].buffer.size();
+	return LogBufferLiveBytes(Logs[handle]);
 }
 
 
@@ -63,10 +78,17 @@ static const char* LogBufferGetLine(LogBufferHandle handle, uint32_t line) {
 	ASSERT(handle != 0);
 	ASSERT(handle < Logs.size());
 	const auto& l = Logs[handle];
-	const auto offset = l.lines.at(line);
+	const auto offset = l.lines.at(line) - l.buffer_start;
 	const auto len = l.buffer.size();
 	if (len <= offset) return "";
-	return &l.buffer[offset];
+	return &l.buffer[(size_t)offset];
+}
+
+
+static uint64_t LogBufferGetFirstLineNumber(LogBufferHandle handle) {
+	ASSERT(handle != 0);
+	ASSERT(handle < Logs.size());
+	return Logs[handle].first_line;
 }
 
 
@@ -76,6 +98,40 @@ static void LogBufferClear(LogBufferHandle handle) {
 	auto& log = Logs[handle];
 	log.lines.clear();
 	log.buffer.clear();
+	log.buffer_start = 0;
+	log.first_line = 0;
+}
+
+
+// drop the oldest lines until `new_bytes` and `new_lines` more fit in the limits
+static void LogBufferEvict(LogBuffer& l, uint64_t new_bytes, uint32_t new_lines) {
+	while (!l.lines.empty()) {
+		const bool too_many_lines = l.max_lines && (l.lines.size() + new_lines > l.max_lines);
+		const bool too_many_bytes = l.max_bytes && (LogBufferLiveBytes(l) + new_bytes > l.max_bytes);
+		if (!too_many_lines && !too_many_bytes) break;
+		l.lines.pop_front();
+		++l.first_line;
+	}
+
+	// the text of dropped lines stays in the buffer until it is at least half of it,
+	// then it is removed in one go so each byte is only moved a constant number of times
+	const uint64_t buffer_end = l.buffer_start + l.buffer.size();
+	const uint64_t live_start = (l.lines.empty()) ? buffer_end : l.lines.front();
+	const auto dead = (size_t)(live_start - l.buffer_start);
+	if (dead && (dead >= l.buffer.size() / 2)) {
+		l.buffer.erase(0, dead);
+		l.buffer_start = live_start;
+	}
+}
+
+
+static void LogBufferSetLimits(LogBufferHandle handle, uint32_t max_bytes, uint32_t max_lines) {
+	ASSERT(handle != 0);
+	ASSERT(handle < Logs.size());
+	auto& l = Logs[handle];
+	l.max_bytes = max_bytes;
+	l.max_lines = max_lines;
+	LogBufferEvict(l, 0, 0);
 }
 
 
@@ -83,13 +139,18 @@ static void LogBufferAppend(LogBufferHandle handle, const char* line) {
 	ASSERT(handle != 0); 
 	ASSERT(handle < Logs.size());
 	auto& l = Logs[handle];
-	auto offset = l.buffer.size();
-	l.buffer.append(line);
-	if (l.buffer.back() == '\n') {
-                l.buffer.pop_back();
+	auto length = strlen(line);
+	if (length && line[length - 1] == '\n') {
+		--length;
+	}
+	// a line that is bigger than the whole buffer is cut to fit
+	if (l.max_bytes && (length >= l.max_bytes)) {
+		length = l.max_bytes - 1;
 	}
+	LogBufferEvict(l, length + 1, 1);
+	l.lines.push_back(l.buffer_start + l.buffer.size());
+	l.buffer.append(line, length);
 	l.buffer += '\0';
-	l.lines.push_back((uint32_t)offset);
 	if (l.logfile) {
 		fputs(line, l.logfile);
 		fputc('\n', l.logfile);
@@ -161,7 +222,11 @@ static constexpr struct log_buffer_api_t LogBufferAPI {
 	&LogBufferGetLine,
 	&LogBufferAppend,
 	&LogBufferRestore,
-	&LogBufferClear
+	&LogBufferClear,
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+	&LogBufferSetLimits,
+	&LogBufferGetFirstLineNumber,
+#endif
 };
 
 
@@ -334,6 +334,8 @@ static void Callback_Config(ConfigAction action) {
         auto s = GetSettingsMutable();
         c->ConfigU32(action, "FontScaleOverride", &s->FontScaleOverride);
         c->ConfigBool(action, "Pause Game when BetterConsole opened", &setting_pause_on_ui_open);
+        c->ConfigBool(action, "Store Config Data As Base64", &s->ConfigDataBase64);
+        c->ConfigBool(action, CONFIG_PER_MOD_FILES_KEY, &s->ConfigPerModFiles);
  
         //do this last until i have this working with the official api
         if (action == ConfigAction_Write) {
@@ -475,6 +477,11 @@ static HRESULT FAKE_Present(IDXGISwapChain3* This, UINT SyncInterval, UINT Prese
                 DEBUG("render heartbeat, showing ui: %s", (should_show_ui)? "true" : "false");
         }
 
+        // pick up edits made to the settings file while the game is running
+        if (EveryNFrames(60)) {
+                PollSettingsRegistry();
+        }
+
         static IDXGISwapChain3* last_swapchain = nullptr;
         static ID3D12CommandQueue* command_queue = nullptr;
 
@@ -559,6 +566,18 @@ static LRESULT FAKE_Wndproc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                         Parser->ParseFloat(" \t \r \n \v  +1.67e-4 \n \r \t \v", &f);
                         DEBUG("f: %f", f);
                 }
+
+                if (wParam == VK_F3) {
+                        ConfigBenchmark();
+                }
+
+                if (wParam == VK_F4) {
+                        ParserBenchmark();
+                }
+
+                if (wParam == VK_F5) {
+                        CSVBenchmark();
+                }
         }
 
         if (uMsg == WM_SIZE || uMsg == WM_CLOSE) {
@@ -28,6 +28,8 @@ constexpr uint32_t GAME_VERSION = BC_MAKE_VERSION(1, 13, 61);
 
 struct ModMenuSettings {
         uint32_t FontScaleOverride = 0;
+        bool ConfigDataBase64 = false;
+        bool ConfigPerModFiles = false;
 };
 
 extern const ModMenuSettings* GetSettings();
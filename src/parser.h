@@ -2,4 +2,17 @@
 
 #include "main.h"
 
-extern const struct parse_api_t* GetParserAPI();
\ No newline at end of file
+extern const struct parse_api_t* GetParserAPI();
+
+//private api
+
+// write a number as text, returns the length or 0 if `out_size` is too small
+// floats use the fewest digits that parse back to the same value, 32 bytes always fit
+extern uint32_t FormatU64(uint64_t value, char* out, uint32_t out_size);
+extern uint32_t FormatS64(int64_t value, char* out, uint32_t out_size);
+extern uint32_t FormatFloat(float value, char* out, uint32_t out_size);
+extern uint32_t FormatDouble(double value, char* out, uint32_t out_size);
+
+#ifdef MODMENU_DEBUG
+extern void ParserBenchmark();
+#endif
\ No newline at end of file
@@ -1,76 +1,193 @@
 #include <Windows.h>
+#include <intrin.h>
+#include <emmintrin.h>
 
 #include <algorithm>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <mutex>
 
 #include "main.h"
 #include "simpledraw.h"
 #include "callback.h"
+#include "parser.h"
+#include "hotkeys.h"
+#include "config_format.h"
 
+#ifdef MODMENU_DEBUG
+#include <chrono>
+#include <thread>
+#endif
 
-#define SETTINGS_REGISTRY_PATH "BetterConsoleConfig.txt"
 
+#define SETTINGS_REGISTRY_PATH "BetterConsoleConfig.txt"
 
-struct Setting {
-        uint64_t key_hash;
-        uint32_t key_offset;
-        uint32_t value_offset;
-};
-constexpr static bool operator < (const Setting& A, const Setting& B) { return A.key_hash < B.key_hash; }
-constexpr static bool operator < (const Setting& A, const uint64_t B) { return A.key_hash < B; }
-constexpr static bool operator < (const uint64_t A, const Setting& B) { return A < B.key_hash; }
 
 struct ConfigFile {
         unsigned char* file_buffer;
+        unsigned char* raw_buffer; // unparsed copy of the file for diffing on reload
         uint64_t buffer_size;
+        uint32_t file_size;
         std::vector<Setting> lines;
         HANDLE out_file;
-        const char* mod_name;
         char file_path[MAX_PATH];
         char* write_buffer;
         uint32_t write_buffer_size;
 };
 
-static ConfigFile* BetterConsoleConfig = nullptr;
+// a published settings table and the writer's bookkeeping for its file
+struct ConfigSlot {
+        std::atomic<ConfigFile*> file;
+        // the last write time and size of the file that the writer has seen,
+        // only used with ConfigWriterLock held, readers never look at them
+        uint64_t stat_time;
+        uint64_t stat_size;
+};
+
+// the published settings table is never modified except for the setting caches
+// readers on any thread pin it with ConfigReadGuard, no locks are taken
+// the writer (loading, saving, reloading) holds ConfigWriterLock and replaces
+// the table with ConfigPublish(), which never waits for readers: the old table
+// goes on a retire list and is freed by a later publish or poll once no reader can have it
+//
+// readers register in the counter of the epoch they started in (epoch % 3). the writer only
+// moves the epoch forward when nobody is left in the epoch before the current one, so
+// readers are only ever in the current or the previous epoch. a table retired in epoch E
+// can only be pinned by readers of epoch E or earlier, which are all gone by epoch E + 2
+static ConfigSlot BetterConsoleConfig{};
+static std::atomic<uint64_t> ConfigEpoch{ 0 };
+static std::atomic<uint32_t> ConfigReaders[3];
+// recursive because a config callback that reads a setting while the settings are being
+// saved may need to load a mod's file, on the thread that already holds the lock
+static std::recursive_mutex ConfigWriterLock;
+
+struct ConfigRetired {
+        ConfigFile* file;
+        uint64_t epoch; // the epoch the table was replaced in
+};
+static std::vector<ConfigRetired> ConfigRetiredFiles; // only used with ConfigWriterLock held
+
+// counts the tables published, so the search index knows when to rebuild
+static std::atomic<uint32_t> ConfigPublishCount{ 0 };
+
+// the mod whose config callback is running, the namespace of the config_api_t functions
+// config callbacks are only sent with ConfigDispatchLock held, so only one thread at a time
+// uses this. reads outside of a config callback name their mod, see ConfigReadU32()
+static const char* ConfigModName = nullptr;
+static std::mutex ConfigDispatchLock;
+
+// settings tables of the mods stored in their own file, see CONFIG_PER_MOD_FILES_KEY
+// slots are only ever added (by the writer), so readers walk the list without a lock
+// the tables in the slots are published and retired the same way as BetterConsoleConfig
+struct ModConfigSlot {
+        ModConfigSlot* next;
+        ConfigSlot slot;
+        char mod_name[32];
+};
+static std::atomic<ModConfigSlot*> ModConfigSlots{ nullptr };
+static ConfigSlot* ConfigSlotFor(const char* mod_name, bool load_if_missing);
+
 static const auto SimpleDraw = GetSimpleDrawAPI();
+static const auto Parser = GetParserAPI();
 
 
-static inline uint64_t hash_fnv1a(const char* str) {
-        uint64_t ret = 0xcbf29ce484222325;
+// pins the published settings tables for the lifetime of the guard
+// and finds the settings of `mod_name` in them
+struct ConfigReadGuard {
+        ConfigFile* file; // NULL if the table was not loaded
+        const char* mod_name;
+        uint32_t counter;
+
+        // the table that holds the settings of `mod_name`, loading the mod's own file if needed
+        explicit ConfigReadGuard(const char* mod_name) : ConfigReadGuard(ConfigSlotFor(mod_name, true), mod_name) {}
+
+        // use a NULL slot or a slot that was looked up without `load_if_missing`
+        ConfigReadGuard(ConfigSlot* slot, const char* mod_name) : mod_name(mod_name) {
+                for (;;) {
+                        const auto epoch = ConfigEpoch.load();
+                        counter = (uint32_t)(epoch % 3);
+                        ConfigReaders[counter].fetch_add(1);
+                        // if the writer moved the epoch after we loaded it, it may have missed
+                        // our increment and will free tables we could still load, try again
+                        if (ConfigEpoch.load() == epoch) break;
+                        ConfigReaders[counter].fetch_sub(1);
+                }
+                file = (slot) ? slot->file.load() : nullptr;
 
-        unsigned char c;
-        while (c = *str++) {
-                ret ^= c;
-                ret *= 0x00000100000001B3;
+                // a mod that was just switched to its own file still has its
+                // settings in the main file until the next save creates it
+                if (file && !file->raw_buffer && (slot != &BetterConsoleConfig)) {
+                        file = BetterConsoleConfig.file.load();
+                }
         }
 
-        return ret;
-}
+        ~ConfigReadGuard() {
+                ConfigReaders[counter].fetch_sub(1, std::memory_order_release);
+        }
+
+        // the setting stays valid for the lifetime of the guard
+        Setting* Find(const char* key_name) const {
+                if (!file || !mod_name) return nullptr;
+                return ConfigFindKey(file->lines, file->file_buffer, mod_name, key_name);
+        }
 
-static char OutputBuffer[4096];
-static unsigned OutputBufferPos = 0;
+        ConfigReadGuard(const ConfigReadGuard&) = delete;
+        ConfigReadGuard& operator=(const ConfigReadGuard&) = delete;
+};
 
-static inline void BufferedOutputFlush() {
-        WriteFile(BetterConsoleConfig->out_file, OutputBuffer, OutputBufferPos, NULL, NULL);
-}
 
-static inline void BufferedOutputWrite(const char* text) {
-        while (*text) {
-                while (OutputBufferPos < sizeof(OutputBuffer)) {
-                        if (!*text) return;
 
-                        OutputBuffer[OutputBufferPos++] = *text++;
-                }
-                WriteFile(BetterConsoleConfig->out_file, OutputBuffer, 4096, NULL, NULL);
-                OutputBufferPos = 0;
-        }
+
+// read the entire file into a buffer rounded up to the page size with space to
+// add a newline character and null terminator, returns NULL if the file could not be opened
+static unsigned char* ConfigReadFile(const char* path, uint32_t* out_file_size, uint64_t* out_buffer_size) {
+        const auto hfile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hfile == INVALID_HANDLE_VALUE) return nullptr; //file does not exist probably
+
+        // Get size of file, make sure its < 4GB
+        LARGE_INTEGER li_file_size;
+        const auto file_size_ret = GetFileSizeEx(hfile, &li_file_size);
+        ASSERT(file_size_ret == TRUE && "Could not get size of file!");
+        ASSERT(li_file_size.QuadPart < UINT32_MAX && "File too large >4GB");
+        const auto file_size = (uint32_t)li_file_size.QuadPart;
+
+        // Round allocation up to page size and make sure there is space to add
+        // a newline character and null terminator
+        const auto buffer_size = (((file_size + 2ULL) + 4095) & ~uint64_t{ 4095 });
+        ASSERT((file_size +2ULL) <= buffer_size && "Math failed me");
+
+        // Allocate memory for file
+        const auto buffer = (unsigned char*)malloc(buffer_size);
+        ASSERT(buffer != NULL && "The impossible happened");
+
+        // Read entire file to ram
+        const auto read_file_ret = ReadFile(hfile, buffer, file_size, NULL, NULL);
+        ASSERT(read_file_ret == TRUE && "Could not read file!");
+
+        // Null out the area at the end of the allocation
+        memset(buffer + file_size, 0, buffer_size - file_size);
+
+        // Ensure the file ends with a newline character for the parser
+        buffer[file_size] = '\n';
+        CloseHandle(hfile);
+
+        *out_file_size = file_size;
+        *out_buffer_size = buffer_size;
+        return buffer;
 }
 
-static inline void BufferedOutputStart() {
-        OutputBufferPos = 0;
+
+// the last write time and size of the file, polled to notice edits made outside the game
+static bool ConfigFileStat(const char* path, uint64_t* out_time, uint64_t* out_size) {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data)) return false;
+        *out_time = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+        *out_size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        return true;
 }
 
+
 // I'm actually very happy with the config loader
 // the only improvement would be memory mapping it
 // but its apparently not possible in win32 to extend the
@@ -89,200 +206,351 @@ extern ConfigFile* ConfigLoadFile(const char* filename) {
         // Initialize c++ object in the struct
         ::new (&ret->lines) decltype(ret->lines);
 
-        // Open settings file
-        const auto hfile = CreateFileA(GetPathInDllDir(ret->file_path, filename), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-        if (hfile == INVALID_HANDLE_VALUE) return ret; //file does not exist probably
+        GetPathInDllDir(ret->file_path, filename);
 
-        // Get size of file, make sure its < 4GB
-        LARGE_INTEGER li_file_size;
-        const auto file_size_ret = GetFileSizeEx(hfile, &li_file_size);
-        ASSERT(file_size_ret == TRUE && "Could not get size of file!");
-        ASSERT(li_file_size.QuadPart < UINT32_MAX && "File too large >4GB");
-        const auto file_size = (uint32_t)li_file_size.QuadPart;
+        ret->raw_buffer = ConfigReadFile(ret->file_path, &ret->file_size, &ret->buffer_size);
+        if (!ret->raw_buffer) return ret;
 
-        // Round allocation up to page size and make sure there is space to add
-        // a newline character and null terminator
-        ret->buffer_size = (((file_size + 2ULL) + 4095) & ~uint64_t{ 4095 });
-        ASSERT((file_size +2ULL) <= ret->buffer_size && "Math failed me");
-
-        // Allocate memory for file
+        // the parser writes null terminators into the buffer, keep the raw
+        // file around so a reload can find which lines were edited
         ret->file_buffer = (unsigned char*)malloc(ret->buffer_size);
         ASSERT(ret->file_buffer != NULL && "The impossible happened");
+        memcpy(ret->file_buffer, ret->raw_buffer, ret->buffer_size);
 
-        // Read entire file to ram
-        const auto read_file_ret = ReadFile(hfile, ret->file_buffer, file_size, NULL, NULL);
-        ASSERT(read_file_ret == TRUE && "Could not read file!");
+        ConfigParseLines(ret->file_buffer, ret->file_buffer, &ret->lines);
 
-        // Null out the area at the end of the allocation
-        memset(ret->file_buffer + file_size, 0, ret->buffer_size - file_size);
+        // because adding key value pairs at runtime is not necessary in this api
+        // we can just sort the array once and use std::equal_range to perform
+        // hash lookups instead of building a hash table
+        std::sort(ret->lines.begin(), ret->lines.end());
+        return ret;
+}
 
-        // Ensure the file ends with a newline character for the parser
-        ret->file_buffer[file_size] = '\n';
-        CloseHandle(hfile);
 
-        // a settings file consists of "key ! value" pairs separated by newlines, using '!' makes the parser more efficient
-        // keys are composed of 2 parts: "mod_name : key_name"
-        // this allows different plugins to have the same key_name without collisions
-        // whitespace is trimmed from the left of mod_name and the right of key_name
-        // the settings file is utf8 encoded, should be plain text, and should be human readable / editable
-        // therefore, you should avoid non-printing characters in keys and values even if while the parser doesn't care
-        // newline characters in keys is restricted (will cause parser to ignore line)
-        // any line where the first non-whitespace character is '#' is treated as a comment and is ignored
-        // therefore keys cannot start with the '#' character (parser will treat it as a comment and ignore it)
-        // text in values is quoted and escaped, so newline restrictions and whitespace trimming does not effect values
-        // duplicate keys in the settings file have no guarantees on which one is retrieved during lookup
-        // settings files have a size limit of 4 gigabytes, I truely hope this limit is never reached
-        // memory consumption for the settings is the aligned size of the file + (16 bytes * number_of_keys) + a small overhead
-        // the settings file buffer is never freed for the life of the application, this means its always valid to
-        // read a setting and allows you to revert settings.
-
-
-        enum token_type : unsigned char {
-                TT_NONE = 0,
-                TT_NULL,
-                TT_NEWLINE,
-                TT_EXCLAIM,
-        };
+static void ConfigFree(ConfigFile* file) {
+        free(file->raw_buffer);
+        free(file->file_buffer);
+        file->lines.~vector();
+        free(file);
+}
 
-        // lookup table for the parser
-        // the only characters the parser cares about are NULL '\0', newline '\n', and exclaimation mark '!'
-        // using some smart (or cursed) programming, the lookup table for the parser can be significantly
-        // smaller than the 256 possible bytes it could encounter
-        // the following parser state is only 64 bytes and should fit into a single cpu cache line
-        unsigned char lookup[40];
-        unsigned char* f = ret->file_buffer - 1; //yep, this is initialized to a value outside the array
-        unsigned char* expos = nullptr; //the position of the exclaimation mark on the current line
-        unsigned char* lastlf = f; //last line feed '\n', initialization out of bounds also intentional
-        memset(lookup, TT_NONE, sizeof(lookup));
-        lookup[0] = TT_NULL;
-        lookup['\n'] = TT_NEWLINE;
-        lookup['!'] = TT_EXCLAIM;
-
-        for (;;) { //yep, this loop is endless, that makes the branch predictor happy
-                ++f;
-
-                const unsigned char c = *f;
-
-                // the most common case (>80% of standard utf8 text)
-                // since the only characters the parser cares about are <= '!'
-                // this tight loop in the first branch makes the predictor very happy
-                // you might wonder why '!' is the most efficient character for this
-                // at 0x21 its the first non-whitespace printable utf8 character
-                if (c > '!') continue;
-
-                const auto t = lookup[c]; //we know c must be in bounds of the array
-
-                // the next most common case would be space ' ' (>80% of remaining characters)
-                // or another character the parser does not need to care about
-                if (!t) continue;
-
-                // we are down to only 3 possible options: TT_NULL, TT_NEWLINE, and TT_EXCLAIM
-                // considering that comment lines are a thing then newline would be more 
-                // common than the '!' character, so check that first
-                if (t == TT_NEWLINE) {
-                        // the parser found a newline character
-                        // this is where we actually try to parse the line
-                        // remove whitespace, etc...
-                        // we know where the last newline was `lastlf`
-                        // we also know if an exclaimation was found `expos`
-                        // we know where the current line ends `f`
-                        // we can determine where the keys and values are using only this info
-                        unsigned char* keypos = lastlf;
-                        lastlf = f;
-
-                        if (!expos) continue; // no '!'? then there can't be a key!value pair 
-
-                        unsigned char* valpos = expos;
-                        expos = nullptr;
-
-                        //step 1: advance keypos until the first non-whitespace character (left-trim)
-                        do {
-                                // on first iteration, unconditionally advance past keypos (lastlf)
-                                // which we know cannot be part of this line's key
-                                ++keypos;
-                        } while (::isspace(*keypos));
-
-                        if (keypos == valpos) continue; //key was empty
-
-                        if (*keypos == '#') continue; //this is a comment line, ignore
-
-                        //step 2: key is not empty, so trim space on the right
-                        unsigned char* null_maker = valpos;
-                        do {
-                                // on the first iteration, null out the '!' character unconditionally
-                                *null_maker = 0; 
-                                --null_maker;
-                        } while (::isspace(*null_maker));
-
-                        //keypos is now null terminated, not empty, and trimmed
-
-                        //Step 4: right trim the value
-                        null_maker = f;
-                        do {
-                                // on the first iteration, null out the newline '\n' character unconditionally
-                                *null_maker = 0;
-                                --null_maker;
-                        } while (::isspace(*null_maker));
-
-                        if (null_maker == valpos) continue; //value was empty
-
-                        //step 5: left trim the value
-                        do {
-                                //on the first iteration, advance past the (now null) '!' character unconditionally
-                                ++valpos; 
-                        } while (::isspace(*valpos));
-
-                        //valpos is now null terminated, not empty, and trimmed
-
-                        // finally, insert the key and value into the array
-                        // the value is not actually parsed until something
-                        // tries to read the key, so the parse time is also lower
-                        Setting s{};
-                        const auto buffer_start = ret->file_buffer;
-                        s.key_hash = hash_fnv1a((const char*)keypos);
-                        s.key_offset = (uint32_t)(keypos - buffer_start);
-                        s.value_offset = (uint32_t)(valpos - buffer_start);
-                        DEBUG("KEY{%s}, VALUE{%s}, HASH{%p}", keypos, valpos, (void*)s.key_hash);
-                        ret->lines.push_back(s);
-                        // a fun excerise is that now would be the perfect time
-                        // for a parser in another thread to transform the value in-place
-                        // values are escaped or otherwise encoded in the config file
-                        // and we could unescape or decode it while this thread continues to parse
-                        // the config file, heck we could even perform the fnv1a hash on the
-                        // other thread too, which would very evenly split the amount of work
-                        // nearly in half, im not sure any other parser out there could do that
-                        // due to our format being so simple. but for now, we just leave it as-is
-                        continue;
-                }
 
-                // we are down to only 2 possible options: TT_EXCLAIM or TT_NULL
-                // TT_EXCLAIM is the most common as we would only parse TT_NULL once
-                // in the entire file, then terminate the parser loop
-                if (t == TT_EXCLAIM) {
-                        expos = f;
-                        continue;
+// length of the common prefix of `a` and `b`, compared 16 bytes at a time
+static uint32_t ConfigMatchForward(const unsigned char* a, const unsigned char* b, uint32_t size) {
+        uint32_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+                const auto eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+                const unsigned long mask = ~(unsigned)_mm_movemask_epi8(eq) & 0xFFFF;
+                unsigned long bit;
+                if (_BitScanForward(&bit, mask)) return i + bit;
+        }
+        while ((i < size) && (a[i] == b[i])) ++i;
+        return i;
+}
+
+
+// length of the common suffix of `a` and `b`, `a_end` and `b_end` point one past the last byte
+static uint32_t ConfigMatchBackward(const unsigned char* a_end, const unsigned char* b_end, uint32_t size) {
+        uint32_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+                const auto eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a_end - i - 16)), _mm_loadu_si128((const __m128i*)(b_end - i - 16)));
+                const unsigned long mask = ~(unsigned)_mm_movemask_epi8(eq) & 0xFFFF;
+                unsigned long bit;
+                if (_BitScanReverse(&bit, mask)) return i + 15 - bit;
+        }
+        while ((i < size) && (a_end[-1 - (ptrdiff_t)i] == b_end[-1 - (ptrdiff_t)i])) ++i;
+        return i;
+}
+
+
+// re-read the settings file after it was edited outside the game
+// only the lines between the first and last changed byte go through the parser,
+// the settings before that range are kept as-is and the ones after it are shifted
+// the mod names of every key that was added, removed, or changed are appended to `changed_mods`
+// returns NULL if the file could not be read or its contents did not change
+static ConfigFile* ConfigReloadFile(const ConfigFile* old, std::vector<std::string>* changed_mods) {
+        uint32_t new_size;
+        uint64_t buffer_size;
+        unsigned char* const raw = ConfigReadFile(old->file_path, &new_size, &buffer_size);
+        if (!raw) return nullptr;
+
+        const uint32_t old_size = old->file_size;
+        const unsigned char* const old_raw = old->raw_buffer;
+        const uint32_t min_size = (old_size < new_size) ? old_size : new_size;
+
+        uint32_t start = 0;
+        uint32_t old_end = old_size + 1;
+        uint32_t new_end = new_size + 1;
+
+        // the parser stops at the first null, which means nothing after a null
+        // in either file was ever parsed, just parse the whole file in that case
+        const bool has_null = memchr(raw, 0, new_size) || (old_raw && memchr(old_raw, 0, old_size));
+        if (old_raw && !has_null) {
+                const uint32_t prefix = ConfigMatchForward(old_raw, raw, min_size);
+                if ((prefix == old_size) && (prefix == new_size)) {
+                        free(raw);
+                        return nullptr; //touched but not changed
                 }
+                const uint32_t suffix = ConfigMatchBackward(old_raw + old_size, raw + new_size, min_size - prefix);
+
+                // expand the changed range to whole lines, the end includes the
+                // newline or the terminator added by ConfigReadFile()
+                start = prefix;
+                while (start && (raw[start - 1] != '\n')) --start;
+                old_end = old_size - suffix;
+                while ((old_end < old_size) && (old_raw[old_end] != '\n')) ++old_end;
+                ++old_end;
+                new_end = old_end + new_size - old_size;
+        }
+
+        ConfigFile* const ret = (decltype(ret))calloc(1, sizeof(*ret));
+        ASSERT(ret != NULL && "Malloc actually failed");
+        ::new (&ret->lines) decltype(ret->lines);
+        memcpy(ret->file_path, old->file_path, sizeof(ret->file_path));
+        ret->raw_buffer = raw;
+        ret->file_size = new_size;
+        ret->buffer_size = buffer_size;
+        ret->file_buffer = (unsigned char*)malloc(buffer_size);
+        ASSERT(ret->file_buffer != NULL && "The impossible happened");
 
-                // the only other option is the terminating condition: TT_NULL
-                // if control flow reaches here we terminate the loop unconditionally
-                // no need to even check if the current token is TT_NULL
-                // in fact, we dont actually check for a null at all anywhere in the parser
-                // we just kind of deduce a null by the process of elimination
-                // i dont really see other parsers out there that would do that
-                // usually most hand written parsers would start off with a for loop like:
-                // for (char *cur = buffer; (*cur && (cur != buffer_end)); ++cur)
-                // or:
-                // for (size_t i = 0; buffer[i] && (i < buffer_size); ++i)
-                // but we eliminated the need for both of those conditions
-                break;
+        // the unchanged lines before the range were already parsed into the old buffer,
+        // the raw range is followed by nulls so the parser stops at the end of it
+        if (start) memcpy(ret->file_buffer, old->file_buffer, start);
+        memcpy(ret->file_buffer + start, raw + start, new_end - start);
+        memset(ret->file_buffer + new_end, 0, buffer_size - new_end);
+
+        // settings outside the range keep their cached values, the ones after it
+        // are shifted by the change in size, filtering keeps them in sorted order
+        ret->lines.reserve(old->lines.size());
+        for (const auto& s : old->lines) {
+                if (s.key_offset < start) {
+                        ret->lines.push_back(s);
+                }
+                else if (s.key_offset >= old_end) {
+                        Setting shifted = s;
+                        shifted.key_offset = s.key_offset + new_end - old_end;
+                        shifted.value_offset = s.value_offset + new_end - old_end;
+                        ret->lines.push_back(shifted);
+                }
         }
-        // because adding key value pairs at runtime is not necessary in this api
-        // we can just sort the array once and use std::equal_range to perform
-        // hash lookups instead of building a hash table
-        std::sort(ret->lines.begin(), ret->lines.end());
+        const size_t first_parsed = ret->lines.size();
+        const auto stop = ConfigParseLines(ret->file_buffer, ret->file_buffer + start, &ret->lines);
+        ASSERT(has_null || (stop == ret->file_buffer + new_end));
+        const size_t last_parsed = ret->lines.size();
+
+        // now fill in the already parsed lines after the range
+        if (old_end <= old_size) memcpy(ret->file_buffer + new_end, old->file_buffer + old_end, old_size + 1 - old_end);
+
+        // diff the keys that were in the range against the keys that are in it now
+        struct KeyValue {
+                const char* key;
+                const char* value;
+        };
+        const auto kv_less = [](const KeyValue& A, const KeyValue& B) noexcept -> bool {
+                const auto k = strcmp(A.key, B.key);
+                return (k) ? (k < 0) : (strcmp(A.value, B.value) < 0);
+        };
+        std::vector<KeyValue> before, after;
+        for (const auto& s : old->lines) {
+                if ((s.key_offset >= start) && (s.key_offset < old_end)) {
+                        before.push_back({ (const char*)old->file_buffer + s.key_offset, (const char*)old->file_buffer + s.value_offset });
+                }
+        }
+        for (size_t i = first_parsed; i < last_parsed; ++i) {
+                const auto& s = ret->lines[i];
+                after.push_back({ (const char*)ret->file_buffer + s.key_offset, (const char*)ret->file_buffer + s.value_offset });
+        }
+        std::sort(before.begin(), before.end(), kv_less);
+        std::sort(after.begin(), after.end(), kv_less);
+
+        const auto mark_changed = [&](const char* key) {
+                const auto colon = strchr(key, ':');
+                if (!colon) return; //not written by this api
+                const std::string mod{ key, colon };
+                if (std::find(changed_mods->begin(), changed_mods->end(), mod) == changed_mods->end()) {
+                        changed_mods->push_back(mod);
+                }
+        };
+        size_t b = 0, a = 0;
+        while ((b < before.size()) || (a < after.size())) {
+                if ((a == after.size()) || ((b < before.size()) && kv_less(before[b], after[a]))) {
+                        mark_changed(before[b++].key);
+                }
+                else if ((b == before.size()) || kv_less(after[a], before[b])) {
+                        mark_changed(after[a++].key);
+                }
+                else {
+                        ++b;
+                        ++a;
+                }
+        }
+
+        DEBUG("Reloaded config file: reparsed %u of %u bytes, %u mods changed", new_end - start, new_size, (unsigned)changed_mods->size());
+        const auto parsed = ret->lines.begin() + first_parsed;
+        std::sort(parsed, ret->lines.end());
+        std::inplace_merge(ret->lines.begin(), parsed, ret->lines.end());
         return ret;
 }
 
+
+// move the epoch forward as far as the readers allow (at most twice, which is as far as it
+// can go), then free the retired tables that no reader can have pinned anymore
+// must be called with ConfigWriterLock held
+static void ConfigReclaim() {
+        for (int i = 0; i < 2; ++i) {
+                const auto epoch = ConfigEpoch.load();
+                if (ConfigReaders[(epoch + 2) % 3].load() != 0) break; //readers of epoch - 1 are not done
+                ConfigEpoch.store(epoch + 1);
+        }
+
+        const auto epoch = ConfigEpoch.load();
+        auto& retired = ConfigRetiredFiles;
+        const auto freed = std::remove_if(retired.begin(), retired.end(), [epoch](const ConfigRetired& r) noexcept -> bool {
+                if (r.epoch + 2 > epoch) return false;
+                ConfigFree(r.file);
+                return true;
+        });
+        retired.erase(freed, retired.end());
+}
+
+
+// make `file` the settings table that readers of `slot` see, the previous
+// table is freed once every reader that could have pinned it is done
+// must be called with ConfigWriterLock held
+static void ConfigPublish(ConfigSlot* slot, ConfigFile* file) {
+        const auto old = slot->file.exchange(file);
+        ConfigPublishCount.fetch_add(1);
+        if (old) ConfigRetiredFiles.push_back({ old, ConfigEpoch.load() });
+        ConfigReclaim();
+}
+
+
+// load `filename` and publish it in `slot`, the file is stat'ed before it
+// is read so an edit that races the read is picked up by the next poll
+// must be called with ConfigWriterLock held
+static void ConfigLoadSlot(ConfigSlot* slot, const char* filename) {
+        char path[MAX_PATH];
+        GetPathInDllDir(path, filename);
+        if (!ConfigFileStat(path, &slot->stat_time, &slot->stat_size)) {
+                slot->stat_time = 0;
+                slot->stat_size = 0;
+        }
+        ConfigPublish(slot, ConfigLoadFile(filename));
+}
+
+
+// mods marked internal with parenthesis like "(hotkeys)" always stay in the main file
+static bool ConfigUsesOwnFile(const char* mod_name) {
+        return mod_name && (*mod_name != '(') && GetSettings()->ConfigPerModFiles;
+}
+
+
+// "BetterConsoleConfig-<mod_name>.txt", characters that are not safe in a file name are
+// replaced and then the hash of the real name is added so that two mods never share a file
+static void ConfigModFileName(const char* mod_name, char* out, uint32_t out_size) {
+        char safe_name[32];
+        bool replaced = false;
+        uint32_t i = 0;
+        for (; mod_name[i] && (i < sizeof(safe_name) - 1); ++i) {
+                const auto c = (unsigned char)mod_name[i];
+                const bool safe = ::isalnum(c) || (c == ' ') || (c == '-') || (c == '_') || (c == '.');
+                safe_name[i] = (safe) ? (char)c : '_';
+                replaced |= !safe;
+        }
+        safe_name[i] = 0;
+
+        if (replaced) {
+                snprintf(out, out_size, "BetterConsoleConfig-%s-%08X.txt", safe_name, (uint32_t)hash_fnv1a(mod_name));
+        }
+        else {
+                snprintf(out, out_size, "BetterConsoleConfig-%s.txt", safe_name);
+        }
+}
+
+
+// the slot holding the table for `mod_name` if it was already loaded, or NULL
+// this is the only part of finding a slot that readers do without a lock
+static ConfigSlot* ConfigFindSlot(const char* mod_name) {
+        for (auto slot = ModConfigSlots.load(std::memory_order_acquire); slot; slot = slot->next) {
+                if (strcmp(slot->mod_name, mod_name) == 0) return &slot->slot;
+        }
+        return nullptr;
+}
+
+
+// ConfigSlotFor() for the writer, which already holds ConfigWriterLock
+static ConfigSlot* ConfigSlotForLocked(const char* mod_name, bool load_if_missing) {
+        if (!ConfigUsesOwnFile(mod_name)) return &BetterConsoleConfig;
+
+        const auto found = ConfigFindSlot(mod_name);
+        if (found || !load_if_missing) return found;
+
+        char filename[MAX_PATH];
+        ConfigModFileName(mod_name, filename, sizeof(filename));
+
+        const auto slot = new ModConfigSlot{};
+        snprintf(slot->mod_name, sizeof(slot->mod_name), "%s", mod_name);
+        ConfigLoadSlot(&slot->slot, filename);
+        slot->next = ModConfigSlots.load();
+        ModConfigSlots.store(slot, std::memory_order_release);
+        return &slot->slot;
+}
+
+
+// the slot holding the table for `mod_name`, either BetterConsoleConfig or the mod's own file
+// the mod's file is loaded the first time it is needed if `load_if_missing` is true,
+// otherwise NULL is returned for a mod whose file was never loaded
+// loading takes ConfigWriterLock, which is fine on the thread that already holds it
+static ConfigSlot* ConfigSlotFor(const char* mod_name, bool load_if_missing) {
+        if (!ConfigUsesOwnFile(mod_name)) return &BetterConsoleConfig;
+
+        const auto found = ConfigFindSlot(mod_name);
+        if (found || !load_if_missing) return found;
+
+        // another thread may have loaded it while we waited
+        ConfigWriterLock.lock();
+        const auto slot = ConfigSlotForLocked(mod_name, true);
+        ConfigWriterLock.unlock();
+        return slot;
+}
+
+
+// after writing the file of `slot` re-read it without sending ConfigAction_Read,
+// so the table (and the search index) match the file and our own write is not
+// treated as an outside edit by the poller
+// must be called with ConfigWriterLock held
+static void ConfigRefreshAfterSave(ConfigSlot* slot) {
+        const auto file = slot->file.load();
+        if (!ConfigFileStat(file->file_path, &slot->stat_time, &slot->stat_size)) return;
+
+        std::vector<std::string> changed_mods;
+        const auto saved = ConfigReloadFile(file, &changed_mods);
+        if (saved) ConfigPublish(slot, saved);
+}
+
+
+// reload the file of `slot` if it was edited outside the game
+// must be called with ConfigWriterLock held
+static void ConfigPollSlot(ConfigSlot* slot, std::vector<std::string>* changed_mods) {
+        const auto old = slot->file.load();
+        uint64_t stat_time, stat_size;
+        if (!old || !ConfigFileStat(old->file_path, &stat_time, &stat_size)) return; //deleted? keep what we have
+        if ((stat_time == slot->stat_time) && (stat_size == slot->stat_size)) return;
+        slot->stat_time = stat_time;
+        slot->stat_size = stat_size;
+
+        const auto file = ConfigReloadFile(old, changed_mods);
+        if (file) ConfigPublish(slot, file);
+}
+
+
+static HANDLE OutputFile = INVALID_HANDLE_VALUE; // set by ConfigOpen()
+
+static void ConfigFlushToFile(const char* data, uint32_t size) {
+        WriteFile(OutputFile, data, size, NULL, NULL);
+}
+
+
 // perform the preparation necessary to write the config file to disk
 extern void ConfigOpen(ConfigFile* file) {
         if ((file->out_file == NULL) || (file->out_file == INVALID_HANDLE_VALUE)) {
@@ -293,16 +561,17 @@ extern void ConfigOpen(ConfigFile* file) {
                 ASSERT("config file is already open");
         }
 
-        file->mod_name = nullptr;
-        BufferedOutputStart();
+        OutputFile = file->out_file;
+        ConfigModName = nullptr;
+        BufferedOutputStart(ConfigFlushToFile, nullptr);
 }
 
 // set the mod_name to namespace the subsequent settings to
+// only inside a config callback, where ConfigDispatchLock is held
 extern void ConfigSetMod(const char* mod_name) {
-        ASSERT(BetterConsoleConfig != NULL);
         ASSERT(mod_name != NULL && "mod_name cannot be NULL");
         ASSERT(!::isspace((unsigned char)*mod_name) && "mod_name cannot start with whitespace");
-        BetterConsoleConfig->mod_name = mod_name;
+        ConfigModName = mod_name;
 }
 
 // perform the necessary actions to finish writing the config file
@@ -310,140 +579,120 @@ extern void ConfigClose(ConfigFile* file) {
         BufferedOutputFlush();
         CloseHandle(file->out_file);
         file->out_file = INVALID_HANDLE_VALUE;
+        OutputFile = INVALID_HANDLE_VALUE;
 }
 
 
-const char* ConfigLookupKey(const char* key_name) {
-        ASSERT(BetterConsoleConfig->mod_name);
-        char key_buffer[128];
-        snprintf(key_buffer, sizeof(key_buffer), "%s:%s", BetterConsoleConfig->mod_name, key_name);
-        const auto hash = hash_fnv1a(key_buffer);
+static inline const char* ConfigSettingValue(const ConfigFile* file, const Setting* setting) {
+        return (const char*)file->file_buffer + setting->value_offset;
+}
 
-        auto range = std::equal_range(BetterConsoleConfig->lines.begin(), BetterConsoleConfig->lines.end(), hash);
 
-        for (auto& i = range.first; i != range.second; i++) {
-                if (strncmp((const char*)BetterConsoleConfig->file_buffer + i->key_offset, key_buffer, sizeof(key_buffer)) == 0) {
-                        return (const char*)BetterConsoleConfig->file_buffer + i->value_offset;
-                }
-        }
+// returns true and sets `out_value` if the setting has a cached value of `type`
+static inline bool ConfigCacheLoad(const Setting* setting, SettingCacheType type, uint32_t* out_value) {
+        const auto cache = setting->cache.load(std::memory_order_relaxed);
+        if ((cache >> 32) != type) return false;
+        *out_value = (uint32_t)cache;
+        return true;
+}
 
-        return nullptr;
+
+static inline void ConfigCacheStore(Setting* setting, SettingCacheType type, uint32_t value) {
+        setting->cache.store(((uint64_t)type << 32) | value, std::memory_order_relaxed);
 }
 
 
 
+// the caches never need to be cleared here, they hold the value of the text in the
+// published table and that text does not change. the save is re-read afterwards by
+// ConfigRefreshAfterSave() and only the lines that changed get new (empty) caches
 static inline void ConfigWriteKey(const char* key_name) {
-        BufferedOutputWrite(BetterConsoleConfig->mod_name);
-        BufferedOutputWrite(":");
-        BufferedOutputWrite(key_name);
-        BufferedOutputWrite("!");
+        ConfigWriteKeyText(ConfigModName, key_name);
 }
 
 
-extern void ConfigU32(ConfigAction action, const char* key_name, uint32_t* value) {
-        if (action == ConfigAction_Read) {
-                const auto val = ConfigLookupKey(key_name);
-                if (val) *value = strtoul(val, nullptr, 0);
+// the typed reads of a setting of the mod pinned by `snapshot`
+// returns false if the setting was not found or could not be parsed, the value is only
+// written on success except for strings which are always null terminated
+static bool ConfigGetU32(const ConfigReadGuard& snapshot, const char* key_name, uint32_t* value) {
+        const auto setting = snapshot.Find(key_name);
+        if (!setting) return false;
+        uint32_t cached;
+        if (!ConfigCacheLoad(setting, SCT_U32, &cached)) {
+                cached = strtoul(ConfigSettingValue(snapshot.file, setting), nullptr, 0);
+                ConfigCacheStore(setting, SCT_U32, cached);
         }
-        else if (action == ConfigAction_Write) {
-                ConfigWriteKey(key_name);
-                char fmt[32];
-                snprintf(fmt, sizeof(fmt), "%u\n", *value);
-                BufferedOutputWrite(fmt);
+        *value = cached;
+        return true;
+}
+
+
+static bool ConfigGetString(const ConfigReadGuard& snapshot, const char* key_name, char* out_buffer, uint32_t buffer_size) {
+        *out_buffer = 0;
+        const auto setting = snapshot.Find(key_name);
+        if (!setting) return false;
+        const char* value = ConfigSettingValue(snapshot.file, setting);
+        uint32_t length;
+        if (ConfigCacheLoad(setting, SCT_String, &length)) {
+                // no escape sequences, the text can be copied as-is
+                if (*value == '\"') ++value;
+                if (length > buffer_size - 1) length = buffer_size - 1;
+                memcpy(out_buffer, value, length);
+                out_buffer[length] = 0;
         }
-        else if (action == ConfigAction_Edit) {
-                ImGui::DragScalar(key_name, ImGuiDataType_U32, value);
+        else if (ConfigReadEscapedString(value, out_buffer, buffer_size, &length)) {
+                ConfigCacheStore(setting, SCT_String, length);
         }
+        return true;
 }
 
-static void ConfigReadEscapedString(const char* in_value, char* out, uint32_t out_size) {
-        const char* v = in_value;
 
-        // we use a quote at the front of the string
-        // to prevent the whitespace trimmer in the
-        // parser from interfering
-        if (*v == '\"') ++v;
+static bool ConfigGetBool(const ConfigReadGuard& snapshot, const char* key_name, bool* out_value) {
+        const auto setting = snapshot.Find(key_name);
+        if (!setting) return false;
+        uint32_t cached;
+        if (!ConfigCacheLoad(setting, SCT_Bool, &cached)) {
+                cached = *ConfigSettingValue(snapshot.file, setting) == '1';
+                ConfigCacheStore(setting, SCT_Bool, cached);
+        }
+        *out_value = (cached != 0);
+        return true;
+}
 
-        for (uint32_t i = 0; i < out_size; ++i) {
-                char outchar = 0;
 
-                //handle escape sequence
-                if (*v == '\\') {
-                        ++v;
-                        switch (*v)
-                        {
-                                // the parser only cares about certain characters
-                                // so only need to handle those
-                        case '0': outchar = 0;
-                                break;
-                        case 'n': outchar = '\n';
-                                break;
-                        case 'e': outchar = '!';
-                                break;
-                        case '\\': outchar = '\\';
-                                break;
-                        case '"': outchar = '"';
-                                break;
-                        default:
-                                //invalid escape sequence
-                                outchar = 0;
-                        }
-                        ++v;
-                } else {
-                        if (*v == '"') {
-                                //all quoted strings are escaped
-                                //therefore, this is the string terminator
-                                outchar = 0;
-                        }
-                        else {
-                                outchar = *v++;
-                        }
-                }
-
-                out[i] = outchar;
-                if (!outchar) break;
+static bool ConfigGetFloat(const ConfigReadGuard& snapshot, const char* key_name, float* out_value) {
+        const auto setting = snapshot.Find(key_name);
+        if (!setting) return false;
+        uint32_t cached;
+        if (!ConfigCacheLoad(setting, SCT_Float, &cached)) {
+                // the parser api is locale independent, unlike strtof
+                float parsed;
+                if (!Parser->ParseFloat(ConfigSettingValue(snapshot.file, setting), &parsed)) return false;
+                memcpy(&cached, &parsed, sizeof(cached));
+                ConfigCacheStore(setting, SCT_Float, cached);
         }
-
-        //ensure null termination
-        out[out_size - 1] = 0;
+        memcpy(out_value, &cached, sizeof(*out_value));
+        return true;
 }
 
 
-static void ConfigWriteEscapedString(const char *in_unescaped_string) {
-        const char* in = in_unescaped_string;
-
-        //so that parser doesnt trim whitespace unintentionally
-        BufferedOutputWrite("\"");
+// the config_api_t functions below are namespaced to ConfigModName, so they may only be
+// used inside a config callback. the Read* functions name the mod and work on any thread
 
-        uint32_t str; // kinda weird
-        while (*in) {
-                if (*in == '\\') {
-                        // works on little-endian platforms
-                        str = ('\\' | ('\\' << 8));
-                }
-                else if (*in == '\n') {
-                        str = ('\\' | ('n' << 8));
-                }
-                else if (*in == '!') {
-                        str = ('\\' | ('e' << 8));
-                }
-                else if (*in == '"') {
-                        str = ('\\' | ('"' << 8));
-                }
-                else {
-                        str = *in;
-                }
-                BufferedOutputWrite((const char*)&str);
-                ++in;
+extern void ConfigU32(ConfigAction action, const char* key_name, uint32_t* value) {
+        if (action == ConfigAction_Read) {
+                ASSERT(ConfigModName && "outside of a config callback, use ReadU32");
+                ConfigGetU32(ConfigReadGuard{ ConfigModName }, key_name, value);
+        }
+        else if (action == ConfigAction_Write) {
+                ConfigWriteKey(key_name);
+                ConfigWriteU32Value(*value);
+        }
+        else if (action == ConfigAction_Edit) {
+                ImGui::DragScalar(key_name, ImGuiDataType_U32, value);
         }
-
-        // insert escape sequence so that the parser doesnt
-        // trim whitespace unintentionally
-        BufferedOutputWrite("\"");
 }
 
-
-
 // configstring:
 //  - should always null terminate out_buffer even if it has to truncate the value
 //  - should escape and unescape the string for proper storage into the config file
@@ -451,17 +700,13 @@ static void ConfigWriteEscapedString(const char *in_unescaped_string) {
 //  - never reads or writes beyond out_buffer[buffer_size - 1]
 static void ConfigString(ConfigAction action, const char* key_name, char* out_buffer, uint32_t buffer_size) {
         if (action == ConfigAction_Read) {
-                *out_buffer = 0;
-                const auto value = ConfigLookupKey(key_name);
-                if (value) {
-                        ConfigReadEscapedString(value, out_buffer, buffer_size);
-                }
+                ASSERT(ConfigModName && "outside of a config callback, use ReadString");
+                ConfigGetString(ConfigReadGuard{ ConfigModName }, key_name, out_buffer, buffer_size);
         }
         else if (action == ConfigAction_Write) {
                 out_buffer[buffer_size - 1] = 0; //now we can assume null termination
                 ConfigWriteKey(key_name);
-                ConfigWriteEscapedString(out_buffer);
-                BufferedOutputWrite("\n"); //move to next line
+                ConfigWriteStringValue(out_buffer);
         }
         else if (action == ConfigAction_Edit) {
                 ImGui::InputText(key_name, out_buffer, buffer_size);
@@ -471,15 +716,12 @@ static void ConfigString(ConfigAction action, const char* key_name, char* out_bu
 
 static void ConfigBool(ConfigAction action, const char* key_name, bool* out_value) {
         if (action == ConfigAction_Read) {
-                const auto value = ConfigLookupKey(key_name);
-                if (value) {
-                        *out_value = *value == '1';
-                }
+                ASSERT(ConfigModName && "outside of a config callback, use ReadBool");
+                ConfigGetBool(ConfigReadGuard{ ConfigModName }, key_name, out_value);
         }
         else if (action == ConfigAction_Write) {
                 ConfigWriteKey(key_name);
-                BufferedOutputWrite((*out_value) ? "1" : "0");
-                BufferedOutputWrite("\n"); //move to next line
+                ConfigWriteBoolValue(*out_value);
         }
         else if (action == ConfigAction_Edit) {
                 SimpleDraw->Checkbox(key_name, out_value);
@@ -488,16 +730,12 @@ static void ConfigBool(ConfigAction action, const char* key_name, bool* out_valu
 
 static void ConfigFloat(ConfigAction action, const char* key_name, float* out_value) {
         if (action == ConfigAction_Read) {
-                const auto value = ConfigLookupKey(key_name);
-                if (value) {
-                        *out_value = strtof(value, nullptr);
-                }
+                ASSERT(ConfigModName && "outside of a config callback, use ReadFloat");
+                ConfigGetFloat(ConfigReadGuard{ ConfigModName }, key_name, out_value);
         }
         else if (action == ConfigAction_Write) {
                 ConfigWriteKey(key_name);
-                char fmt[32];
-                snprintf(fmt, sizeof(fmt), "%f\n", *out_value);
-                BufferedOutputWrite(fmt);
+                ConfigWriteFloatValue(*out_value);
         }
         else if (action == ConfigAction_Edit) {
                 SimpleDraw->DragFloat(key_name, out_value, 0.f, 0.f);
@@ -505,68 +743,72 @@ static void ConfigFloat(ConfigAction action, const char* key_name, float* out_va
 }
 
 
-static bool ConfigReadData(const char* in_data, char* out_buffer, uint32_t buffer_size) {
-        static unsigned char lookup[64] = { 0 };
-
-        if (!lookup[0]) {
-                // intentionally repeating 0-9
-                constexpr const char const hexchars[] = "0123456789ABCDEF0123456789abcdef";
-                memset(lookup, 255, sizeof(lookup));
-                for (unsigned i = 0; i < sizeof(hexchars); i++) {
-                        lookup[hexchars[i] - '0'] = i & 0xF;
+static bool ConfigData(ConfigAction action, const char* key_name, void* out_data, uint32_t data_size) {
+        if (action == ConfigAction_Read) {
+                ASSERT(ConfigModName && "outside of a config callback, use ReadData");
+                const ConfigReadGuard snapshot{ ConfigModName };
+                const auto setting = snapshot.Find(key_name);
+                if (setting) {
+                        return ConfigReadData(ConfigSettingValue(snapshot.file, setting), (char*)out_data, data_size);
                 }
         }
+        else if (action == ConfigAction_Write) {
+                ConfigWriteKey(key_name);
+                ConfigWriteDataValue(out_data, data_size, GetSettings()->ConfigDataBase64);
+                return true;
+        } 
+        return true;
+}
 
-        const char* s = in_data;
-        for (uint32_t i = 0; i < buffer_size; i++) {
-                const unsigned char c1 = (unsigned char)*s++ - '0';
-                const unsigned char c2 = (unsigned char)*s++ - '0';
-                const unsigned char v1 = lookup[c1 & 63];
-                const unsigned char v2 = lookup[c2 & 63];
-                if ((c1 | c2 | v1 | v2) & 192) return false; //in_data has invalid chars
-                out_buffer[i] = v1 << 4 | v2;
-        }
 
-        return *s == 0;
+extern bool ConfigReadU32(const char* mod_name, const char* key_name, uint32_t* value) {
+        return ConfigGetU32(ConfigReadGuard{ mod_name }, key_name, value);
 }
 
 
-static void ConfigWriteData(const char* in_data, uint32_t data_size) {
-        static const char* const hex{ "0123456789ABCDEF" };
-        for (uint32_t i = 0; i < data_size; i++) {
-                const auto c = (unsigned char)in_data[i];
-                char byte[3];
-                byte[0] = hex[(c >> 4) & 0xF];
-                byte[1] = hex[c & 0xF];
-                byte[2] = 0;
-                BufferedOutputWrite(hex);
-        }
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+static bool ConfigApiReadU32(RegistrationHandle handle, const char* key_name, uint32_t* value) {
+        return ConfigGetU32(ConfigReadGuard{ CallbackGetName(handle) }, key_name, value);
 }
 
 
-static bool ConfigData(ConfigAction action, const char* key_name, void* out_data, uint32_t data_size) {
-        if (action == ConfigAction_Read) {
-                const auto value = ConfigLookupKey(key_name);
-                if (value) {
-                        return ConfigReadData(value, (char*)out_data, data_size);
-                }
-        }
-        else if (action == ConfigAction_Write) {
-                ConfigWriteKey(key_name);
-                ConfigWriteData((char*)out_data, data_size);
-                BufferedOutputWrite("\n"); //move to next line
-                return true;
-        } 
-        return true;
+static bool ConfigApiReadString(RegistrationHandle handle, const char* key_name, char* out_buffer, uint32_t buffer_size) {
+        return ConfigGetString(ConfigReadGuard{ CallbackGetName(handle) }, key_name, out_buffer, buffer_size);
+}
+
+
+static bool ConfigApiReadBool(RegistrationHandle handle, const char* key_name, bool* out_value) {
+        return ConfigGetBool(ConfigReadGuard{ CallbackGetName(handle) }, key_name, out_value);
+}
+
+
+static bool ConfigApiReadFloat(RegistrationHandle handle, const char* key_name, float* out_value) {
+        return ConfigGetFloat(ConfigReadGuard{ CallbackGetName(handle) }, key_name, out_value);
 }
 
 
+static bool ConfigApiReadData(RegistrationHandle handle, const char* key_name, void* out_data, uint32_t data_size) {
+        const ConfigReadGuard snapshot{ CallbackGetName(handle) };
+        const auto setting = snapshot.Find(key_name);
+        if (!setting) return false;
+        return ConfigReadData(ConfigSettingValue(snapshot.file, setting), (char*)out_data, data_size);
+}
+#endif
+
+
 static constexpr const struct config_api_t Config = {
         ConfigU32,
         ConfigString,
         ConfigBool,
         ConfigFloat,
-        ConfigData
+        ConfigData,
+#ifdef BETTERAPI_DEVELOPMENT_FEATURES
+        ConfigApiReadU32,
+        ConfigApiReadString,
+        ConfigApiReadBool,
+        ConfigApiReadFloat,
+        ConfigApiReadData,
+#endif
 };
 
 
@@ -576,31 +818,364 @@ extern const struct config_api_t* GetConfigAPI() {
 
 
 extern void LoadSettingsRegistry() {
-        ASSERT(BetterConsoleConfig == nullptr && "BetterConsoleConfig is already loaded");
-        BetterConsoleConfig = ConfigLoadFile(SETTINGS_REGISTRY_PATH);
+        ConfigWriterLock.lock();
+        ASSERT(BetterConsoleConfig.file.load() == nullptr && "BetterConsoleConfig is already loaded");
+        ConfigLoadSlot(&BetterConsoleConfig, SETTINGS_REGISTRY_PATH);
+        ConfigWriterLock.unlock();
+
+        // this decides where every other mod's settings are read from, so it has to be known first
+        // the mods stored in their own file are loaded when their callback reads a setting
+        ConfigGetBool(ConfigReadGuard{ "(internal)" }, CONFIG_PER_MOD_FILES_KEY, &GetSettingsMutable()->ConfigPerModFiles);
         
         uint32_t num_config;
         const auto config = CallbackGetHandles(CALLBACKTYPE_CONFIG, &num_config);
+        ConfigDispatchLock.lock();
         for (unsigned i = 0; i < num_config; i++) {
-                BetterConsoleConfig->mod_name = CallbackGetName(config[i]);
+                ConfigModName = CallbackGetName(config[i]);
                 const auto callback = CallbackGetCallback(CALLBACKTYPE_CONFIG, config[i]);
                 callback.config_callback(ConfigAction_Read);
         }
+        ConfigModName = nullptr;
+        ConfigDispatchLock.unlock();
 }
 
 extern void SaveSettingsRegistry() {
-        ASSERT(BetterConsoleConfig != nullptr && "BetterConsoleConfig was not loaded");
-        ConfigOpen(BetterConsoleConfig);
-
         uint32_t num_config;
         const auto config = CallbackGetHandles(CALLBACKTYPE_CONFIG, &num_config);
+        ConfigDispatchLock.lock();
+        ConfigWriterLock.lock();
+        const auto file = BetterConsoleConfig.file.load();
+        ASSERT(file != nullptr && "BetterConsoleConfig was not loaded");
+        ConfigOpen(file);
+
         for (unsigned i = 0; i < num_config; i++) {
-                BetterConsoleConfig->mod_name = CallbackGetName(config[i]);
+                const auto name = CallbackGetName(config[i]);
+                if (ConfigUsesOwnFile(name)) continue;
+                ConfigModName = name;
                 const auto callback = CallbackGetCallback(CALLBACKTYPE_CONFIG, config[i]);
                 callback.config_callback(ConfigAction_Write);
         }
 
-        ConfigClose(BetterConsoleConfig);
+        ConfigClose(file);
+        ConfigRefreshAfterSave(&BetterConsoleConfig);
+
+        // each mod in its own file is written to memory first and the
+        // file is only replaced if the mod's settings actually changed
+        std::string output;
+        for (unsigned i = 0; i < num_config; i++) {
+                const auto name = CallbackGetName(config[i]);
+                if (!ConfigUsesOwnFile(name)) continue;
+
+                output.clear();
+                BufferedOutputStart(nullptr, &output);
+                ConfigModName = name;
+                const auto callback = CallbackGetCallback(CALLBACKTYPE_CONFIG, config[i]);
+                callback.config_callback(ConfigAction_Write);
+                BufferedOutputFlush();
+
+                const auto slot = ConfigSlotForLocked(name, true);
+                const auto mod_file = slot->file.load();
+                if ((output.size() == mod_file->file_size) && (output.empty() || !memcmp(output.data(), mod_file->raw_buffer, output.size()))) {
+                        continue;
+                }
+
+                DEBUG("Writing config file: '%s'", mod_file->file_path);
+                const auto hfile = CreateFileA(mod_file->file_path, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+                ASSERT(hfile != INVALID_HANDLE_VALUE);
+                WriteFile(hfile, output.data(), (DWORD)output.size(), NULL, NULL);
+                CloseHandle(hfile);
+                ConfigRefreshAfterSave(slot);
+        }
+        ConfigWriterLock.unlock();
+        ConfigModName = nullptr;
+        ConfigDispatchLock.unlock();
+}
+
+
+// call periodically, if any settings file was edited outside the game then reload
+// it and send ConfigAction_Read to the mods that had settings changed
+extern void PollSettingsRegistry() {
+        // a save or reload is already running on another thread, check again next time
+        if (!ConfigWriterLock.try_lock()) return;
+
+        std::vector<std::string> changed_mods;
+        ConfigPollSlot(&BetterConsoleConfig, &changed_mods);
+        for (auto slot = ModConfigSlots.load(); slot; slot = slot->next) {
+                ConfigPollSlot(&slot->slot, &changed_mods);
+        }
+        // free the tables that were still pinned when they were replaced
+        ConfigReclaim();
+        ConfigWriterLock.unlock();
+
+        for (const auto& mod : changed_mods) {
+                DEBUG("Settings changed for mod: '%s'", mod.c_str());
+        }
+
+        uint32_t num_config;
+        const auto config = CallbackGetHandles(CALLBACKTYPE_CONFIG, &num_config);
+        ConfigDispatchLock.lock();
+        for (unsigned i = 0; i < num_config; i++) {
+                const auto name = CallbackGetName(config[i]);
+                if (std::find(changed_mods.begin(), changed_mods.end(), name) == changed_mods.end()) continue;
+                ConfigModName = name;
+                const auto callback = CallbackGetCallback(CALLBACKTYPE_CONFIG, config[i]);
+                callback.config_callback(ConfigAction_Read);
+        }
+        ConfigModName = nullptr;
+        ConfigDispatchLock.unlock();
+
+        if (std::find(changed_mods.begin(), changed_mods.end(), "(hotkeys)") != changed_mods.end()) {
+                HotkeyReloadSettings();
+        }
+}
+
+
+#ifdef MODMENU_DEBUG
+// debug only: reader threads pin and read a settings table while this thread keeps reloading
+// it, every table a reader sees must be complete and never older than the one it saw before
+// a table freed while it was pinned shows up as garbage values (or a crash)
+static void ConfigStressTest() {
+        #define STRESS_MOD "(stress test)"
+        constexpr uint32_t key_count = 256;
+        constexpr uint32_t reader_count = 4;
+        constexpr uint32_t publish_count = 5000;
+
+        // every setting of version `v` has the value `v`, like a reload of an edited file
+        const auto make_table = [](uint32_t version) -> ConfigFile* {
+                std::string text;
+                char line[128];
+                for (uint32_t i = 0; i < key_count; ++i) {
+                        snprintf(line, sizeof(line), STRESS_MOD ":key %u!%u\n", i, version);
+                        text += line;
+                }
+                snprintf(line, sizeof(line), STRESS_MOD ":name!\"version %u\"\n", version);
+                text += line;
+
+                ConfigFile* const ret = (decltype(ret))calloc(1, sizeof(*ret));
+                ASSERT(ret != NULL && "Malloc actually failed");
+                ::new (&ret->lines) decltype(ret->lines);
+                ret->file_size = (uint32_t)text.size();
+                ret->buffer_size = text.size() + 1;
+                ret->raw_buffer = (unsigned char*)malloc(ret->buffer_size);
+                ret->file_buffer = (unsigned char*)malloc(ret->buffer_size);
+                ASSERT(ret->raw_buffer && ret->file_buffer);
+                memcpy(ret->raw_buffer, text.c_str(), ret->buffer_size);
+                memcpy(ret->file_buffer, text.c_str(), ret->buffer_size);
+                ConfigParseLines(ret->file_buffer, ret->file_buffer, &ret->lines);
+                std::sort(ret->lines.begin(), ret->lines.end());
+                return ret;
+        };
+
+        static ConfigSlot slot{}; //not in ModConfigSlots, so only the test sees it
+        ConfigWriterLock.lock();
+        ConfigPublish(&slot, make_table(0));
+        ConfigWriterLock.unlock();
+
+        std::atomic<bool> done{ false };
+        std::atomic<uint32_t> errors{ 0 };
+        std::atomic<uint64_t> reads{ 0 };
+        const auto reader = [&](uint32_t seed) {
+                uint32_t last_version = 0;
+                uint64_t count = 0;
+                while (!done.load(std::memory_order_relaxed)) {
+                        const ConfigReadGuard snapshot{ &slot, STRESS_MOD };
+                        uint32_t version = UINT32_MAX;
+                        bool ok = true;
+                        for (uint32_t i = 0; i < 8; ++i) {
+                                seed = seed * 1664525 + 1013904223;
+                                char key[32];
+                                snprintf(key, sizeof(key), "key %u", (seed >> 8) % key_count);
+                                uint32_t value;
+                                ok &= ConfigGetU32(snapshot, key, &value);
+                                if (version == UINT32_MAX) version = value;
+                                ok &= (value == version);
+                        }
+                        char name[32], expected[32];
+                        ok &= ConfigGetString(snapshot, "name", name, sizeof(name));
+                        snprintf(expected, sizeof(expected), "version %u", version);
+                        ok &= (strcmp(name, expected) == 0) && (version >= last_version);
+                        if (!ok) errors.fetch_add(1);
+                        last_version = version;
+                        ++count;
+                }
+                reads.fetch_add(count);
+        };
+
+        std::vector<std::thread> readers;
+        for (uint32_t i = 0; i < reader_count; ++i) readers.emplace_back(reader, i * 7919 + 1);
+
+        size_t max_retired = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t version = 1; version <= publish_count; ++version) {
+                const auto table = make_table(version);
+                ConfigWriterLock.lock();
+                ConfigPublish(&slot, table);
+                if (ConfigRetiredFiles.size() > max_retired) max_retired = ConfigRetiredFiles.size();
+                ConfigWriterLock.unlock();
+        }
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        done.store(true);
+        for (auto& t : readers) t.join();
+
+        ConfigWriterLock.lock();
+        ConfigPublish(&slot, nullptr);
+        const auto left = ConfigRetiredFiles.size();
+        ConfigWriterLock.unlock();
+
+        DEBUG("Settings stress test: %u readers, %u reloads in %.2f s, %llu reads, at most %u tables waiting to be freed, %u left, %u errors",
+                reader_count, publish_count, seconds, (unsigned long long)reads.load(), (unsigned)max_retired, (unsigned)left, errors.load());
+        #undef STRESS_MOD
+}
+
+
+// debug only: the settings format benchmark, round trip, and fuzz, see ConfigFormatBenchmark()
+// and the stress test of the readers and writer
+// results go to the debug log, the test renderer runs this with F3
+extern void ConfigBenchmark() {
+        // the writer's output buffer is shared with saving
+        ConfigWriterLock.lock();
+        ConfigFormatBenchmark();
+        ConfigWriterLock.unlock();
+
+        ConfigStressTest();
+}
+#endif // MODMENU_DEBUG
+
+
+// lowercase copies of every key and value in the settings tables for the
+// search box in the settings tab, rebuilt whenever a new table is published
+struct SettingsSearchIndex {
+        uint32_t publish_count;
+        bool built;
+        std::vector<char> text; // per setting: mod, key, value, lowercase "mod:key\nvalue"
+        std::vector<uint32_t> settings; // offset of each setting's text, sorted by mod and key
+        std::vector<uint32_t> matches; // the settings matching `query`
+        char query[128];
+        char last_query[128];
+};
+static SettingsSearchIndex SearchIndex{};
+static uint32_t SettingsTabSelection = 0;
+
+
+static void SettingsSearchAdd(const char* mod_name, const char* key_name, const char* value) {
+        auto& index = SearchIndex;
+        const auto mod_len = strlen(mod_name);
+        const auto key_len = strlen(key_name);
+        const auto value_len = strlen(value);
+
+        index.settings.push_back((uint32_t)index.text.size());
+        index.text.insert(index.text.end(), mod_name, mod_name + mod_len + 1);
+        index.text.insert(index.text.end(), key_name, key_name + key_len + 1);
+        index.text.insert(index.text.end(), value, value + value_len + 1);
+        for (size_t i = 0; i < mod_len; ++i) index.text.push_back((char)::tolower((unsigned char)mod_name[i]));
+        index.text.push_back(':');
+        for (size_t i = 0; i < key_len; ++i) index.text.push_back((char)::tolower((unsigned char)key_name[i]));
+        index.text.push_back('\n');
+        for (size_t i = 0; i < value_len; ++i) index.text.push_back((char)::tolower((unsigned char)value[i]));
+        index.text.push_back(0);
+}
+
+
+// index the settings of every mod with a config callback from the table its reads use,
+// so a mod in its own file is not listed twice and keys of removed mods are left out
+// returns false if a save or reload holds the settings on another thread, try again next frame
+static bool SettingsSearchRebuild() {
+        uint32_t num_config;
+        const auto config = CallbackGetHandles(CALLBACKTYPE_CONFIG, &num_config);
+
+        // the own files of mods that did not read a setting yet are loaded here, like a read would
+        if (!ConfigWriterLock.try_lock()) return false;
+        for (uint32_t i = 0; i < num_config; ++i) {
+                ConfigSlotForLocked(CallbackGetName(config[i]), true);
+        }
+        ConfigWriterLock.unlock();
+
+        auto& index = SearchIndex;
+        index.text.clear();
+        index.settings.clear();
+        index.last_query[0] = 0;
+        index.publish_count = ConfigPublishCount.load();
+        index.built = true;
+
+        // values are shown decoded, a string without its quote and escape sequences
+        char value[256];
+        uint32_t value_length;
+        for (uint32_t i = 0; i < num_config; ++i) {
+                const auto mod_name = CallbackGetName(config[i]);
+                const auto mod_len = strlen(mod_name);
+                const ConfigReadGuard snapshot{ ConfigSlotFor(mod_name, false), mod_name };
+                if (!snapshot.file) continue;
+
+                for (const auto& line : snapshot.file->lines) {
+                        const auto key = (const char*)snapshot.file->file_buffer + line.key_offset;
+                        if (strncmp(key, mod_name, mod_len) || (key[mod_len] != ':')) continue;
+                        ConfigReadEscapedString(ConfigSettingValue(snapshot.file, &line), value, sizeof(value), &value_length);
+                        SettingsSearchAdd(mod_name, key + mod_len + 1, value);
+                }
+        }
+
+        // the tables are sorted by hash, sort by mod then key for display
+        const auto text = index.text.data();
+        std::sort(index.settings.begin(), index.settings.end(), [text](uint32_t A, uint32_t B) noexcept -> bool {
+                const auto mod_cmp = strcmp(text + A, text + B);
+                if (mod_cmp) return mod_cmp < 0;
+                return strcmp(text + A + strlen(text + A) + 1, text + B + strlen(text + B) + 1) < 0;
+        });
+        return true;
+}
+
+
+// the mod, key, value, and search text of a setting in the index
+static const char* SettingsSearchField(uint32_t setting, uint32_t field) {
+        const char* str = SearchIndex.text.data() + setting;
+        while (field--) str += strlen(str) + 1;
+        return str;
+}
+
+
+static void SettingsSearchFilter() {
+        auto& index = SearchIndex;
+        if (!index.built || (index.publish_count != ConfigPublishCount.load())) {
+                SettingsSearchRebuild();
+        }
+        if (strcmp(index.query, index.last_query) == 0) return;
+        memcpy(index.last_query, index.query, sizeof(index.last_query));
+
+        char query[sizeof(index.query)];
+        for (uint32_t i = 0; i < sizeof(query); ++i) {
+                query[i] = (char)::tolower((unsigned char)index.query[i]);
+        }
+
+        index.matches.clear();
+        for (const auto setting : index.settings) {
+                if (strstr(SettingsSearchField(setting, 3), query)) {
+                        index.matches.push_back(setting);
+                }
+        }
+}
+
+
+static void draw_search_cell(uintptr_t, int row, int column) {
+        const auto setting = SearchIndex.matches[row];
+        if (column != 0) {
+                ImGui::TextUnformatted(SettingsSearchField(setting, column));
+                return;
+        }
+
+        // clicking a row opens that mod's settings
+        const auto mod = SettingsSearchField(setting, 0);
+        if (ImGui::Selectable(mod, false, ImGuiSelectableFlags_SpanAllColumns)) {
+                uint32_t num_config;
+                const auto config = CallbackGetHandles(CALLBACKTYPE_CONFIG, &num_config);
+                for (uint32_t i = 0; i < num_config; ++i) {
+                        if (strcmp(CallbackGetName(config[i]), mod) == 0) {
+                                SettingsTabSelection = i;
+                                SearchIndex.query[0] = 0;
+                                break;
+                        }
+                }
+        }
 }
 
 
@@ -618,7 +1193,16 @@ extern void draw_settings_tab() {
                 return;
         }
 
-        static uint32_t selection = 0;
+        SimpleDraw->InputText("Search Settings", SearchIndex.query, sizeof(SearchIndex.query), false);
+        if (SearchIndex.query[0]) {
+                static const char* const headers[] = { "Mod", "Key", "Value" };
+                SettingsSearchFilter();
+                SimpleDraw->Table(headers, sizeof(headers) / sizeof(headers[0]), 0, (uint32_t)SearchIndex.matches.size(), draw_search_cell);
+                return;
+        }
+
+        auto& selection = SettingsTabSelection;
+        if (selection >= num_config) selection = 0;
         SimpleDraw->HBoxLeft(0.f, 12.f);
         if (SimpleDraw->Button("Save Configuration")) {
                 SaveSettingsRegistry(); //TODO: this doesnt get the hotkeys
@@ -627,7 +1211,11 @@ extern void draw_settings_tab() {
         SimpleDraw->HBoxRight();
         if (selection >= 0) {
                 const auto callback = CallbackGetCallback(CALLBACKTYPE_CONFIG, config[selection]);
+                ConfigDispatchLock.lock();
+                ConfigModName = CallbackGetName(config[selection]);
                 callback.config_callback(ConfigAction_Edit);
+                ConfigModName = nullptr;
+                ConfigDispatchLock.unlock();
         }
         SimpleDraw->HBoxEnd();
 }
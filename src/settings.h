@@ -4,8 +4,18 @@
 extern const struct config_api_t* GetConfigAPI();
 
 //private api
+
+// setting of the "(internal)" mod, when true other mods are stored in their own config file
+#define CONFIG_PER_MOD_FILES_KEY "Store Each Mod In Its Own Config File"
+
 extern void LoadSettingsRegistry();
 extern void SaveSettingsRegistry();
+extern void PollSettingsRegistry();
+#ifdef MODMENU_DEBUG
+extern void ConfigBenchmark();
+#endif
 
 extern void ConfigSetMod(const char* mod_name);
+// read a setting of `mod_name` from any thread, returns false if it was not found
+extern bool ConfigReadU32(const char* mod_name, const char* key_name, uint32_t* value);
 extern void draw_settings_tab();
\ No newline at end of file
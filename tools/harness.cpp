@@ -0,0 +1,62 @@
+// Runs the debug-only checks and benchmarks of the modules that do not depend on
+// windows or the game as a normal program, so they can be used on linux and under
+// the sanitizers. The debug log goes to stdout instead of BetterConsoleLog.txt.
+//
+// build and run from the root of the repository:
+//   g++ -std=c++17 -O2 -DBETTERAPI_DEVELOPMENT_FEATURES tools/harness.cpp src/parser.cpp src/config_format.cpp -o harness
+//   ./harness            (or ./harness parser settings)
+//
+// add "-g -fsanitize=address,undefined" to check for out of bounds reads,
+// any clang or gcc with sse2 works, c++14 builds skip the std::from_chars timings
+
+#include "../src/main.h"
+#include "../src/parser.h"
+#include "../src/config_format.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+
+extern void DebugImpl(const char* const filename, const char* const func, int line, const char* const fmt, ...) noexcept {
+        printf("%s:%s:%d>", filename, func, line);
+        va_list args;
+        va_start(args, fmt);
+        vprintf(fmt, args);
+        va_end(args);
+        putchar('\n');
+        fflush(stdout);
+}
+
+
+extern void AssertImpl(const char* const filename, const char* const func, int line, const char* const text) noexcept {
+        printf("ASSERTION FAILURE %s:%s:%d>%s\n", filename, func, line, text);
+        fflush(stdout);
+        abort();
+}
+
+
+extern void TraceImpl(const char* const filename, const char* const func, int line, const char* const fmt, ...) noexcept {
+        printf("%s:%s:%d>", filename, func, line);
+        va_list args;
+        va_start(args, fmt);
+        vprintf(fmt, args);
+        va_end(args);
+        putchar('\n');
+}
+
+
+int main(int argc, char** argv) {
+        // run everything, or only the parts named on the command line
+        const auto run = [argc, argv](const char* name) -> bool {
+                if (argc < 2) return true;
+                for (int i = 1; i < argc; ++i) {
+                        if (strcmp(argv[i], name) == 0) return true;
+                }
+                return false;
+        };
+
+        if (run("parser")) ParserBenchmark();
+        if (run("settings")) ConfigFormatBenchmark();
+        return 0;
+}